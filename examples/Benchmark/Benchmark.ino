@@ -0,0 +1,155 @@
+//******************************************************************************************************
+//
+// Example for the Arduino RS-Bus library: benchmark of the selected decoding variant.
+//
+// RSbusVariants.h offers several variants to decode the RS-bus signal (SW, SW_Tx, SW_TCBx, RTC, HW_TCBx,
+// HW_TCA0 and HW_Tx). This sketch measures, for the variant that is compiled in, the costs and the results:
+// - load:  the fraction of CPU time taken by the RS-bus interrupts. First a busy loop, that only
+//          calls checkPolling(), counts its iterations while the RS-bus ISR is not attached. Next the
+//          same loop is executed with the RS-bus ISR attached. The loss of iterations is the time
+//          taken by the ISR(s). Dividing that time by the number of pulses received gives:
+// - isrUs: the ISR time per RS-bus pulse, in microseconds. For the hardware based variants (RTC,
+//          HW_TCBx, HW_TCA0 and HW_Tx) most pulses don't raise an interrupt, thus this value is very low.
+// - pollUs / connUs: the average execution time of a checkPolling() and a checkConnection() call
+//          from the main loop, in microseconds.
+// - nibblesPerSec: the number of RS-bus messages send per second, while the sketch tries to keep
+//          the transmit queue filled.
+// If RSBUS_STATISTICS is defined in RSbusVariants.h, also the average and maximum execution time of the
+// ISR itself are printed (see sup_stats.h).
+//
+// After every measurement a single line is printed, to be processed by a spreadsheet or script:
+// BENCH variant=SW load=1.95% isrUs=3.08 pollUs=2.10 connUs=5.31 nibblesPerSec=49.8 cycles=250 errors=0
+// The decoder needs a RS-bus signal, from a command station or from the CommandStation_Simulator.
+//
+// 2026-10-14 / AG: Initial version
+//
+//******************************************************************************************************
+#include <Arduino.h>
+#include <RSbus.h>
+
+// The following parameters specify the hardware that is being used and the RS-Bus address
+const uint8_t RsBus_USART = 0;       // Use USART-0. On most boards TX, TXD, TX0 or TXD0
+const uint8_t RsBus_RX = 2;          // INTx: Arduino UNO DCC Shield is Pin 2
+const uint8_t RS_Address = 100;      // Must be a value between 1..128
+const uint16_t LOAD_MS = 1000;       // Duration of each busy loop
+const uint16_t SEND_MS = 5000;       // Duration of the throughput measurement
+
+#if defined(RSBUS_USES_SW_4MS)
+  const char variant[] = "SW_4MS";
+#elif defined(RSBUS_USES_SW_T1)
+  const char variant[] = "SW_T1";
+#elif defined(RSBUS_USES_SW_T3)
+  const char variant[] = "SW_T3";
+#elif defined(RSBUS_USES_SW_T4)
+  const char variant[] = "SW_T4";
+#elif defined(RSBUS_USES_SW_T5)
+  const char variant[] = "SW_T5";
+#elif defined(RSBUS_USES_SW_TCB0) || defined(RSBUS_USES_SW_TCB1) || defined(RSBUS_USES_SW_TCB2) || \
+      defined(RSBUS_USES_SW_TCB3) || defined(RSBUS_USES_SW_TCB4)
+  const char variant[] = "SW_TCB";
+#elif defined(RSBUS_USES_HW_TCB0) || defined(RSBUS_USES_HW_TCB1) || defined(RSBUS_USES_HW_TCB2) || \
+      defined(RSBUS_USES_HW_TCB3) || defined(RSBUS_USES_HW_TCB4)
+  const char variant[] = "HW_TCB";
+#elif defined(RSBUS_USES_HW_TCA0)
+  const char variant[] = "HW_TCA";
+#elif defined(RSBUS_USES_HW_T1) || defined(RSBUS_USES_HW_T3) || defined(RSBUS_USES_HW_T4) || \
+      defined(RSBUS_USES_HW_T5)
+  const char variant[] = "HW_T";
+#elif defined(RSBUS_USES_RTC)
+  const char variant[] = "RTC";
+#else
+  const char variant[] = "SW";
+#endif
+
+extern RSbusHardware rsbusHardware;  // This object is defined in rs_bus.cpp
+RSbusConnection rsbus;               // Per RS-Bus address we need a dedicated object
+uint32_t idleLoops;                  // Iterations of the busy loop, without RS-bus ISR
+uint8_t value;                       // The value we will send over the RS-Bus
+
+
+//******************************************************************************************************
+uint32_t busyLoop(void) {
+  // Counts how often checkPolling() can be called within LOAD_MS
+  uint32_t loops = 0;
+  unsigned long tStart = millis();
+  while ((millis() - tStart) < LOAD_MS) {
+    rsbusHardware.checkPolling();
+    loops++;
+  }
+  return loops;
+}
+
+
+void measure(void) {
+  RSbusTelemetry before;
+  RSbusTelemetry after;
+  // Step 1: CPU load of the ISR(s)
+  rsbusHardware.getTelemetry(before);
+  uint32_t loops = busyLoop();
+  rsbusHardware.getTelemetry(after);
+  float load = (loops < idleLoops) ? (1.0 - (float) loops / idleLoops) : 0.0;
+  uint32_t pulses = (after.cycles - before.cycles) * 130;
+  float isrUs = (pulses) ? (load * LOAD_MS * 1000.0 / pulses) : 0.0;
+  // Step 2: throughput and main loop overhead. Every 40ms (2 polling cycles) both nibbles change
+  uint32_t pollTime = 0;
+  uint32_t connTime = 0;
+  uint32_t calls = 0;
+  unsigned long tLastSend = millis();
+  rsbusHardware.getTelemetry(before);
+  unsigned long tStart = millis();
+  while ((millis() - tStart) < SEND_MS) {
+    if (rsbus.feedbackRequested) rsbus.send8bits(value);
+    if ((millis() - tLastSend) >= 40) {
+      tLastSend = millis();
+      value = ~value;
+      rsbus.send8bits(value);
+    }
+    unsigned long t1 = micros();
+    rsbusHardware.checkPolling();
+    unsigned long t2 = micros();
+    rsbus.checkConnection();
+    unsigned long t3 = micros();
+    pollTime += t2 - t1;
+    connTime += t3 - t2;
+    calls++;
+  }
+  rsbusHardware.getTelemetry(after);
+  uint32_t errors = (after.parityErrors - before.parityErrors) +
+                    (after.pulseCountErrors - before.pulseCountErrors) +
+                    (after.signalLosses - before.signalLosses);
+  // Step 3: print the results
+  Serial.print("BENCH variant=");  Serial.print(variant);
+  Serial.print(" load=");          Serial.print(load * 100.0);
+  Serial.print("% isrUs=");        Serial.print(isrUs);
+  Serial.print(" pollUs=");        Serial.print((float) pollTime / calls);
+  Serial.print(" connUs=");        Serial.print((float) connTime / calls);
+  Serial.print(" nibblesPerSec="); Serial.print((after.nibblesSent - before.nibblesSent) * 1000.0 / SEND_MS, 1);
+  Serial.print(" cycles=");        Serial.print(after.cycles - before.cycles);
+  Serial.print(" errors=");        Serial.print(errors);
+  #if defined(RSBUS_STATISTICS)
+  RSbusStatistics statistics;
+  rsbusHardware.getStatistics(statistics);
+  Serial.print(" isrAvgUs=");      Serial.print(statistics.isr.average());
+  Serial.print(" isrMaxUs=");      Serial.print(statistics.isr.max);
+  rsbusHardware.clearStatistics();
+  #endif
+  Serial.println();
+}
+
+
+//**************************************** Main *******************************************
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  rsbus.address = RS_Address;        // 1.. 128
+  idleLoops = busyLoop();            // Reference: no RS-bus ISR yet
+  rsbusHardware.attach(RsBus_USART, RsBus_RX);
+  unsigned long tStart = millis();   // Wait (at most 2 seconds) for a valid RS-bus signal
+  while (!rsbusHardware.rsSignalIsOK && ((millis() - tStart) < 2000)) rsbusHardware.checkPolling();
+  if (!rsbusHardware.rsSignalIsOK) Serial.println("No RS-bus signal");
+}
+
+
+void loop() {
+  measure();
+}
@@ -0,0 +1,124 @@
+//******************************************************************************************************
+//
+// Example for the Arduino RS-Bus library: benchmark of the nibble encoding.
+//
+// Since version 2.5 the RS-Bus messages (nibbles) are no longer calculated at run time, but taken
+// from a table that is calculated by the compiler and stored in flash. This sketch shows how many
+// CPU cycles this saves. It compares:
+// - legacy: the encoding used up to version 2.4 (bit reversal, parity_even_bit() and the TT bits),
+//   followed by storing the nibble in the FIFO of version 2.4 (a fixed buffer per connection)
+// - library: send4bits() and send8bits() of the current library, which include storing the
+//   nibble(s) in the FIFO
+// The results are printed on the serial monitor, in CPU cycles per nibble.
+//
+// Note that the RS-Bus hardware is not attached. Since no RS-Bus signal is received,
+// checkConnection() empties the FIFO of the connection, which is done outside the timed part.
+//
+// 2026-10-14 / AG: Initial version
+//
+//******************************************************************************************************
+#include <Arduino.h>
+#include <util/parity.h>
+#include <RSbus.h>
+
+const uint8_t BATCH = 16;            // Nibbles per measurement. Must fit in the FIFO pool (FIFO_POOL_SIZE)
+const uint16_t ROUNDS = 200;         // Number of measurements
+static_assert(BATCH <= FIFO_POOL_SIZE, "BATCH nibbles must fit in the FIFO pool");
+
+
+//******************************************************************************************************
+// The legacy encoding, as used in version 2.4 of the library
+//******************************************************************************************************
+const uint8_t LEGACY_FIFO_SIZE = 32;
+uint8_t buffer[LEGACY_FIFO_SIZE];
+uint8_t head, tail, numElements;
+volatile uint8_t type = 1;           // Feedback. Volatile, to avoid that the compiler optimises it away
+
+void legacyPush(uint8_t data) {
+  if (numElements == LEGACY_FIFO_SIZE) return;
+  numElements++;
+  if (numElements > 1) {
+    tail++;
+    tail %= LEGACY_FIFO_SIZE;
+  }
+  buffer[tail] = data;
+}
+
+void legacyEmpty(void) {
+  head = 0;
+  tail = 0;
+  numElements = 0;
+}
+
+void __attribute__((noinline)) legacyFormat(uint8_t value) {
+  if (type == 0) {value |= (1<<2) | (0<<1);}   // switch decoder with feedback
+  if (type == 1) {value |= (0<<2) | (1<<1);}   // feedback module
+  if (parity_even_bit(value)) {value |= 0;}
+    else {value |= 1;}
+  legacyPush(value);
+}
+
+void __attribute__((noinline)) legacySend4bits(uint8_t nibble, uint8_t value) {
+  uint8_t data = ((value & 0b00000001) <<7)
+               | ((value & 0b00000010) <<5)
+               | ((value & 0b00000100) <<3)
+               | ((value & 0b00001000) <<1)
+               | (nibble<<3);
+  legacyFormat(data);
+}
+
+
+//******************************************************************************************************
+RSbusConnection rsbus;
+unsigned long legacyTime;
+unsigned long send4Time;
+unsigned long send8Time;
+
+
+void printResult(const char *text, unsigned long time) {
+  // Convert the total time (in us) into CPU cycles per nibble
+  unsigned long nibbles = (unsigned long)BATCH * ROUNDS;
+  Serial.print(text);
+  Serial.print((time * (F_CPU / 1000000UL)) / nibbles);
+  Serial.println(" cycles per nibble");
+}
+
+
+void setup() {
+  Serial.begin(115200);
+  rsbus.address = 1;
+  unsigned long tStart;
+  // legacy encoding
+  for (uint16_t round = 0; round < ROUNDS; round++) {
+    legacyEmpty();
+    tStart = micros();
+    for (uint8_t i = 0; i < BATCH; i++) legacySend4bits(i & 1, i);
+    legacyTime += micros() - tStart;
+  }
+  // send4bits() of the library
+  for (uint16_t round = 0; round < ROUNDS; round++) {
+    rsbus.checkConnection();                   // No RS-Bus signal: empties the FIFO
+    tStart = micros();
+    for (uint8_t i = 0; i < BATCH; i++) rsbus.send4bits((i & 1) ? HighBits : LowBits, i);
+    send4Time += micros() - tStart;
+  }
+  // send8bits() of the library. All bits change, thus each call results in two nibbles
+  uint8_t value = 0x00;
+  for (uint16_t round = 0; round < ROUNDS; round++) {
+    rsbus.checkConnection();
+    tStart = micros();
+    for (uint8_t i = 0; i < BATCH / 2; i++) {
+      value = value ^ 0xFF;
+      rsbus.send8bits(value);
+    }
+    send8Time += micros() - tStart;
+  }
+  Serial.println("RS-Bus nibble encoding benchmark");
+  printResult("legacy encoding (v2.4): ", legacyTime);
+  printResult("library send4bits():    ", send4Time);
+  printResult("library send8bits():    ", send8Time);
+}
+
+
+void loop() {
+}
@@ -0,0 +1,175 @@
+//******************************************************************************************************
+//
+// Example for the Arduino RS-Bus library: RS-Bus command station simulator.
+//
+// The purpose of this sketch is to test and benchmark RS-bus decoders, without the need for a real
+// command station and a logic analyser. It runs on a second Arduino, that generates the RS-bus polling
+// signal for the decoder under test, and receives the RS-bus messages send by that decoder.
+// The following conditions can be simulated:
+// a) normal operation: pulse trains of 130 pulses, followed by 7ms of silence
+// b) noise: an extra pulse within a pulse train
+// c) missing pulses: a pulse train with less than 130 pulses
+// d) parity errors: 10,7ms of silence after a pulse train, as if the master received a corrupted byte
+// e) signal loss: a period of silence of more than 12ms
+// Each condition is injected with a configurable probability (see below). In addition, each received
+// byte is checked for correct parity; after an incorrect byte, the simulator also remains silent for
+// 10,7ms, as a real master does.
+//
+// After every REPORT_CYCLES polling cycles a single line is printed, to be processed by a spreadsheet
+// or script. For example:
+// SIM cycles=500 nibbles=996 perCycle=1.99 rxParity=0 noise=5 missing=4 parity=6 loss=1 recAvg=2.1 recMax=4
+// - nibbles / perCycle: the number of messages received, in total and per polling cycle (throughput)
+// - rxParity: received messages with an incorrect parity bit
+// - noise, missing, parity, loss: the number of errors injected
+// - recAvg / recMax: the recovery time: the number of polling cycles between an injected error and the
+//   first message received after that error.
+// Latency can not be measured here, since the simulator doesn't know when the decoder's sketch handed
+// over its data. Define RSBUS_LATENCY in RSbusVariants.h of the decoder under test for that purpose.
+// The decoder under test should send regularly, for example by running Example_including_RSBus_check.
+// This sketch is an optional extra, for tests on real hardware. The regression tests of the library
+// itself run on a PC, without any hardware: see extras/sim.
+//
+// Hardware: a board with a second USART (Serial1), such as the Arduino MEGA or DxCore boards.
+// - pulsePin drives the RS-bus receive input of the decoder under test. Without RS-bus hardware in
+//   between, the decoder's receive pin can be connected directly to pulsePin.
+// - The USART transmit pin of the decoder under test should be connected to the RX1 pin.
+// - Both boards should share GND.
+//
+// 2026-10-14 / AG: Initial version
+//
+//******************************************************************************************************
+#include <Arduino.h>
+
+const uint8_t pulsePin = 8;             // Output towards the decoder under test
+const uint8_t rxPin = 19;               // RX1 pin. MEGA: 19. Used to detect the start bit
+const uint8_t ledPin = 13;              // Pin for the LED. Usually Pin 13
+
+// Probabilities, in percent per polling cycle, of the injected errors
+const uint8_t noisePct = 1;             // An extra pulse
+const uint8_t missingPct = 1;           // A pulse less
+const uint8_t parityPct = 1;            // 10,7ms of silence
+const uint8_t lossPct = 0;              // 20ms of silence
+const uint16_t REPORT_CYCLES = 500;     // Number of polling cycles per report line
+
+
+//******************************************************************************************************
+// Timing of the RS-bus signal (see extras/BasicOperation.md)
+const uint8_t T_HIGH = 113;             // High part of a pulse (us)
+const uint8_t T_LOW = 90;               // Low part of a pulse (us)
+const uint16_t T_BYTE = 2100;           // Start, 8 data and stop bit at 4800 baud, plus margin (us)
+const uint16_t T_SILENCE = 7000;        // Normal period of silence after a pulse train (us)
+const uint16_t T_PARITY = 10700;        // Silence after a parity error (us)
+const uint16_t T_LOSS = 20000;          // Silence that a decoder should see as signal loss (us)
+
+// Counters for the report
+uint16_t cycles;
+uint16_t nibbles;
+uint16_t rxParity;
+uint16_t injectedNoise;
+uint16_t injectedMissing;
+uint16_t injectedParity;
+uint16_t injectedLoss;
+uint16_t recoveries;                    // Number of recovery times measured
+uint32_t recoverySum;                   // Sum of the recovery times (cycles)
+uint8_t recoveryMax;                    // Longest recovery time (cycles)
+bool recovering;                        // An error was injected, and no message was received since
+uint8_t recoveryCycles;                 // Cycles since that error
+
+
+//******************************************************************************************************
+void pulse(void) {
+  digitalWrite(pulsePin, HIGH);
+  delayMicroseconds(T_HIGH);
+  digitalWrite(pulsePin, LOW);
+  delayMicroseconds(T_LOW);
+}
+
+
+bool receiveByte(void) {
+  // A decoder that is polled starts transmission immediately after the pulse. Like the master, we
+  // wait with the next pulse until the byte is received. Returns true if the parity was incorrect
+  if (digitalRead(rxPin) == HIGH) return false;  // No start bit, thus this address has no data
+  unsigned long tStart = micros();
+  while ((Serial1.available() == 0) && ((micros() - tStart) < T_BYTE)) {;}
+  if (Serial1.available() == 0) return false;
+  uint8_t data = Serial1.read();
+  nibbles++;
+  if (recovering) {
+    recovering = false;
+    recoveries++;
+    recoverySum += recoveryCycles;
+    if (recoveryCycles > recoveryMax) recoveryMax = recoveryCycles;
+  }
+  // The parity bit makes the number of 1 bits odd
+  if (__builtin_parity(data) == 0) {
+    rxParity++;
+    return true;
+  }
+  return false;
+}
+
+
+void pollingCycle(void) {
+  uint8_t pulses = 130;
+  bool parityError = false;
+  if (random(100) < noisePct) {pulses++; injectedNoise++; recovering = true; recoveryCycles = 0;}
+  else if (random(100) < missingPct) {pulses--; injectedMissing++; recovering = true; recoveryCycles = 0;}
+  for (uint8_t i = 0; i < pulses; i++) {
+    pulse();
+    if (receiveByte()) parityError = true;
+  }
+  uint16_t silence = T_SILENCE;
+  if (random(100) < parityPct) {silence = T_PARITY; injectedParity++; recovering = true; recoveryCycles = 0;}
+  if (random(100) < lossPct) {silence = T_LOSS; injectedLoss++; recovering = true; recoveryCycles = 0;}
+  if (parityError && (silence < T_PARITY)) silence = T_PARITY;
+  delayMicroseconds(silence / 2);       // delayMicroseconds() is limited to 16383us
+  delayMicroseconds(silence - (silence / 2));
+  if (recovering && (recoveryCycles < 255)) recoveryCycles++;
+  cycles++;
+}
+
+
+void report(void) {
+  Serial.print("SIM cycles=");   Serial.print(cycles);
+  Serial.print(" nibbles=");     Serial.print(nibbles);
+  Serial.print(" perCycle=");    Serial.print((float) nibbles / cycles);
+  Serial.print(" rxParity=");    Serial.print(rxParity);
+  Serial.print(" noise=");       Serial.print(injectedNoise);
+  Serial.print(" missing=");     Serial.print(injectedMissing);
+  Serial.print(" parity=");      Serial.print(injectedParity);
+  Serial.print(" loss=");        Serial.print(injectedLoss);
+  Serial.print(" recAvg=");      Serial.print((recoveries) ? ((float) recoverySum / recoveries) : 0.0);
+  Serial.print(" recMax=");      Serial.println(recoveryMax);
+  cycles = 0;
+  nibbles = 0;
+  rxParity = 0;
+  injectedNoise = 0;
+  injectedMissing = 0;
+  injectedParity = 0;
+  injectedLoss = 0;
+  recoveries = 0;
+  recoverySum = 0;
+  recoveryMax = 0;
+}
+
+
+//**************************************** Main *******************************************
+void setup() {
+  pinMode(pulsePin, OUTPUT);
+  pinMode(ledPin, OUTPUT);
+  digitalWrite(pulsePin, LOW);
+  Serial.begin(115200);
+  Serial1.begin(4800);                  // RS-bus messages: 8 bit, no parity, 1 stop bit
+  randomSeed(analogRead(0));
+  delay(500);
+  Serial.println("Start");
+}
+
+
+void loop() {
+  pollingCycle();
+  if (cycles >= REPORT_CYCLES) {
+    digitalWrite(ledPin, !digitalRead(ledPin));
+    report();
+  }
+}
@@ -13,12 +13,15 @@
 // by the RSbus master or not.
 // Retransmission is reactive, and sends a copy only after a transmission error was signalled
 // by the RSbus master
+// If 'rsbus.adaptiveFEC' is set, 'rsbus.forwardErrorCorrection' becomes the maximum number of copies;
+// copies are then only send after the RS-bus has recently shown parity or pulse count errors.
 //
 // We send every second an 8 bit value. The values will be 0 or 255 
 // The library will devide these 8 bits into two RS-Bus messages.
 // First the low-level nibble is send, followed by the high level nibble (a nibble carries 4 bits).
 //
 // 2021-11-30 / AP: Initial version (Tested on Arduino UNO with Arduino UNO DCC Shield)
+// 2026-10-14 / AG: adaptiveFEC added
 //
 //******************************************************************************************************
 #include <Arduino.h>
@@ -30,6 +33,7 @@ const uint8_t RsBus_USART = 0;       // Use USART-0. On most boards TX, TXD, TX0
 const uint8_t RsBus_RX = 2;          // INTx: Arduino UNO DCC Shield is Pin 2
 const uint8_t RS_Address = 112;      // Must be a value between 1..128
 const uint8_t data_copies = 1;       // Reasonable values: 0 (=no copies) / 1 or 2.
+const bool adaptive = false;         // true: copies only if the RS-bus recently had errors
 
 // Instatiate the objects being used
 // The RSbushardware object is responsible for the RS-Bus interrupts and USART.
@@ -47,6 +51,7 @@ void setup() {
   value = 0;                         // Initial value
   pinMode(ledPin, OUTPUT); 
   rsbus.forwardErrorCorrection = data_copies;
+  rsbus.adaptiveFEC = adaptive;
 }
 
 
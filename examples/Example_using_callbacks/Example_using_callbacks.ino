@@ -0,0 +1,68 @@
+//******************************************************************************************************
+//
+// Test sketch for the Arduino RS-Bus library
+// In this sketch the library calls the sketch, instead of the sketch polling the library
+//
+// With serviceConnections the connections are serviced by checkPolling(), and onFeedbackRequested
+// replaces the polling of feedbackRequested. The main loop therefore only calls checkPolling(),
+// and sleeps (idle mode) in between. The RS-bus interrupts, and the timer behind micros(), wake
+// the processor again.
+// Every second one of the feedback bits toggles. The LED shows if the RS-bus signal is OK.
+//
+// 2026-10-14 / AG: Initial version
+//
+//******************************************************************************************************
+#include <Arduino.h>
+#include <avr/sleep.h>
+#include <RSbus.h>
+
+// The following parameters specify the hardware that is being used and the RS-Bus address
+const uint8_t ledPin = 13;           // Pin for the LED
+const uint8_t RsBus_USART = 0;       // Use USART-0. On most boards TX, TXD, TX0 or TXD0
+const uint8_t RsBus_RX = 2;          // INTx: Arduino UNO DCC Shield is Pin 2
+const uint8_t RS_Address = 100;      // Must be a value between 1..128
+
+
+extern RSbusHardware rsbusHardware;  // This object is defined in rs_bus.cpp
+RSbusConnection rsbus;               // Per RS-Bus address we need a dedicated object
+unsigned long T_last;                // We change a feedback bit every second
+uint8_t value;                       // The value we will send over the RS-Bus
+
+
+//******************************************************************************************************
+// The callbacks. These are called by checkPolling(), thus not from an ISR
+void feedbackRequested(RSbusConnection &connection) {
+  connection.send8bits(value);       // The master needs all 8 bits (again)
+}
+
+void signalOk(void) {
+  digitalWrite(ledPin, 1);
+}
+
+void signalLost(void) {
+  digitalWrite(ledPin, 0);
+}
+
+
+//**************************************** Main *******************************************
+void setup() {
+  pinMode(ledPin, OUTPUT);
+  rsbus.address = RS_Address;        // 1.. 128
+  rsbus.onFeedbackRequested = feedbackRequested;
+  rsbusHardware.onSignalOk = signalOk;
+  rsbusHardware.onSignalLost = signalLost;
+  rsbusHardware.serviceConnections = true;
+  rsbusHardware.attach(RsBus_USART, RsBus_RX);
+  set_sleep_mode(SLEEP_MODE_IDLE);
+}
+
+
+void loop() {
+  if ((millis() - T_last) > 1000) {
+    T_last = millis();
+    value = value ^ 0x01;
+    rsbus.send8bits(value);          // Queued; only the changed nibble is send
+  }
+  rsbusHardware.checkPolling();      // Also calls checkConnection() and the callbacks
+  sleep_mode();                      // Wait for the next interrupt
+}
@@ -0,0 +1,54 @@
+//******************************************************************************************************
+//
+// Test sketch for the Arduino RS-Bus library
+// In this sketch a feedback decoder with 16 inputs reads its inputs via RSbusInputs
+//
+// The inputs are connected to two complete ports, and pulled up by the processor. An active input
+// connects the pin to ground. RSbusInputs reads per port all 8 inputs at once, debounces them and
+// sends the changes via the two RS-bus addresses of a bank. It also answers the master after a
+// (re)synchronisation, thus the main loop doesn't need to do anything else.
+// Traditional ATMega processors (such as the UNO) read for example PINC; MegaCoreX and DxCore
+// processors read PORTC.IN. portInputRegister() selects the right register for the given pin.
+//
+// 2026-10-14 / AG: Initial version
+//
+//******************************************************************************************************
+#include <Arduino.h>
+#include <RSbus.h>
+
+// The following parameters specify the hardware that is being used and the RS-Bus address
+const uint8_t RsBus_USART = 0;       // Use USART-0. On most boards TX, TXD, TX0 or TXD0
+const uint8_t RsBus_RX = 2;          // INTx: Arduino UNO DCC Shield is Pin 2
+const uint8_t RS_Address = 100;      // Must be a value between 1..127 (we use two addresses)
+const uint8_t firstPinPortA = A0;    // A pin of the port with inputs 1..8
+const uint8_t firstPinPortB = 4;     // A pin of the port with inputs 9..16
+
+
+extern RSbusHardware rsbusHardware;  // This object is defined in rs_bus.cpp
+RSbusBank bank(2);                   // Two RS-bus addresses, thus 16 feedback bits
+RSbusInputs inputs;                  // Reads and debounces the inputs
+
+
+void setPullUps(uint8_t pin) {
+  // All 8 pins of the port become inputs with pull-up
+  for (uint8_t p = 0; p < NUM_DIGITAL_PINS; p++) {
+    if (digitalPinToPort(p) == digitalPinToPort(pin)) pinMode(p, INPUT_PULLUP);
+  }
+}
+
+
+void setup() {
+  setPullUps(firstPinPortA);
+  setPullUps(firstPinPortB);
+  bank.baseAddress = RS_Address;     // Inputs 1..8 use RS_Address, 9..16 RS_Address + 1
+  inputs.addByte(portInputRegister(digitalPinToPort(firstPinPortA)), bank, 0);
+  inputs.addByte(portInputRegister(digitalPinToPort(firstPinPortB)), bank, 1);
+  rsbusHardware.attach(RsBus_USART, RsBus_RX);
+}
+
+
+void loop() {
+  rsbusHardware.checkPolling();
+  inputs.check();
+  bank.check();
+}
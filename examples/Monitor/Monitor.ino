@@ -8,7 +8,25 @@
 // c) if a decoder takes 4ms for transmission (double byte), instead of 2ms 
 // d) if interference from external electrical sources insert exra pulses 
 //
+// The monitor is a capture engine: the state machine that checks the RS-bus every ms doesn't print
+// anything itself, but writes compact event records (time, event type, address or pulse count) into
+// a ring buffer. The main loop drains that buffer to Serial, but only as many records as fit in the
+// Serial transmit buffer, so Serial never blocks and the 1ms checks are never delayed. Should the ring
+// buffer nevertheless fill up, the number of lost records is reported by an "overflow" record.
+// The records can be send as text (readable in the Serial Monitor) or, for long or busy captures, in a
+// binary format that can be converted into text by the host script monitor_decode.py:
+//   python3 monitor_decode.py /dev/ttyUSB0            (or: a file that holds a binary capture)
+//
+// Sniffer mode (define SNIFFER below): on boards with a second USART, the monitor also receives the
+// messages that the decoders send to the command station. Each byte is matched to the address being
+// polled, its parity and TT bits are checked, and a map with the 8 feedback bits of all 128 addresses
+// is maintained. Only changes of that map are reported ("Feedback 12: 0x5A"), as well as bytes with an
+// incorrect parity or TT bits ("Bad byte 12: 0x..."). The "address" lines of the normal monitor are
+// then no longer reported. Note that the RS-bus data line can not be connected directly to the USART
+// RX pin; it needs a RS-bus receiver, such as described in extras/Monitor.md.
+//
 // 2021-11-9 / AP: Version 1
+// 2026-10-14 / AG: Version 2 - ring buffer and non-blocking output, binary output format, sniffer mode
 //
 // This sketch is inspired by the RS-bus library software, but does NOT use the RS-bus library itself.
 // Has been tested on the Arduino UNO and the AVR128-DA48 Curiosity Board
@@ -33,6 +51,9 @@
 
 const uint8_t RsBus_RX = 2;             // See above
 const uint8_t ledPin = 13;              // Pin for the LED. Usually Pin 13
+const bool binaryOutput = false;        // true: binary records for monitor_decode.py, false: text
+const bool captureCycles = false;       // true: also a record for every correct polling cycle
+// #define SNIFFER Serial1              // USART that receives the RS-bus data (4800 baud)
 
 
 //******************************************************************************************************
@@ -44,6 +65,36 @@ uint8_t addressPolled;                  // Local copy (to avoid changes by the I
 uint8_t previousAddressPolled = 0;      // Previous value of addressPolled
 bool signalDetected = false;            // Flag: RS-bus signal is detected and address is synchronized
 
+// Event records. In binary mode every record is send as 9 bytes: RECORD_SYNC, type, value, data,
+// time (4 bytes, ms, little endian) and a checksum (XOR of type, value, data and the time bytes)
+enum EventType {
+  evStart,                              // The sketch has started
+  evMessage,                            // value: the address that send a message
+  evDoubleByte,                         // value: the address that took 4ms for transmission
+  evCountError,                         // value: the number of pulses in the pulse train
+  evParityError,                        // The command station signals a parity error
+  evSignalDetected,
+  evSignalLost,
+  evOverflow,                           // value: number of records lost, since the ring buffer was full
+  evCycle,                              // value: 130. Only if captureCycles is set
+  evFeedback,                           // Sniffer. value: the address, data: its new feedback bits
+  evBadByte                             // Sniffer. value: the address, data: the byte received
+};
+
+struct EventRecord {
+  uint32_t time;                        // millis() at the moment the event was detected
+  uint8_t type;                         // EventType
+  uint8_t value;
+  uint8_t data;                         // Only used by the sniffer events
+};
+
+const uint8_t RECORD_SYNC = 0xA5;       // First byte of a binary record
+const uint8_t RING_SIZE = 64;           // Must be a power of 2
+EventRecord ring[RING_SIZE];
+uint8_t ringHead = 0;                   // Next record to write (free running)
+uint8_t ringTail = 0;                   // Next record to send (free running)
+uint8_t lost = 0;                       // Records lost since the last overflow record (saturates)
+
 enum PollState {                        // The state machine for detct_address
   polling,
   matchedFirst,
@@ -63,17 +114,148 @@ enum PollState {                        // The state machine for detct_address
 
 //**************************************** ISR *******************************************  
 // Interrupt Service Machine
+#if defined(SNIFFER)
+volatile unsigned long tLastPulse;      // micros() of the latest pulse
+volatile uint8_t gapAddress;            // Address polled before the latest gap of more than 1ms
+#endif
+
 void rs_interrupt(void) {
+  #if defined(SNIFFER)
+  // The master stops polling while a decoder transmits. Remember which address was polled before
+  // such gap, in case the received byte is read after polling has resumed
+  unsigned long now = micros();
+  if (((now - tLastPulse) > 1000) && (isrCounter != 0)) gapAddress = isrCounter - 1;
+  tLastPulse = now;
+  #endif
   isrCounter ++;        // Address of slave that gets his turn next
 }
 
+
+//************************************* Ring buffer ****************************************
+void store(uint8_t type, uint8_t value, uint8_t data) {
+  EventRecord &record = ring[ringHead % RING_SIZE];
+  record.time = millis();
+  record.type = type;
+  record.value = value;
+  record.data = data;
+  ringHead++;
+}
+
+
+void capture(uint8_t type, uint8_t value = 0, uint8_t data = 0) {
+  // Called by the state machine. Takes a few microseconds, independent of the Serial speed
+  #if defined(SNIFFER)
+  if (type == evMessage) return;        // The sniffer reports changes of the data instead
+  #endif
+  uint8_t used = ringHead - ringTail;
+  if (lost) {
+    // Report the loss first, as soon as there is room for the report and the new record
+    if (used >= (RING_SIZE - 1)) {if (lost < 255) lost++; return;}
+    store(evOverflow, lost, 0);
+    lost = 0;
+  }
+  else if (used >= RING_SIZE) {lost = 1; return;}
+  store(type, value, data);
+}
+
+
+void printByte(const EventRecord &record) {
+  Serial.print(record.value);
+  Serial.print(": 0x");
+  if (record.data < 0x10) Serial.print('0');
+  Serial.println(record.data, HEX);
+}
+
+
+void sendText(const EventRecord &record) {
+  switch (record.type) {
+    case evStart:          Serial.println("Start"); break;
+    case evMessage:        Serial.println(record.value); break;
+    case evDoubleByte:     Serial.print("Double byte: "); Serial.println(record.value); break;
+    case evCountError:     Serial.print("Count error: "); Serial.println(record.value); break;
+    case evParityError:    Serial.println("Parity Error"); break;
+    case evSignalDetected: Serial.println("Signal detected"); break;
+    case evSignalLost:     Serial.println("Signal lost"); break;
+    case evOverflow:       Serial.print("Overflow: "); Serial.println(record.value); break;
+    case evCycle:          Serial.println("Cycle"); break;
+    case evFeedback:       Serial.print("Feedback "); printByte(record); break;
+    case evBadByte:        Serial.print("Bad byte "); printByte(record); break;
+  }
+}
+
+
+void sendBinary(const EventRecord &record) {
+  uint8_t buffer[9];
+  buffer[0] = RECORD_SYNC;
+  buffer[1] = record.type;
+  buffer[2] = record.value;
+  buffer[3] = record.data;
+  buffer[4] = record.time;
+  buffer[5] = record.time >> 8;
+  buffer[6] = record.time >> 16;
+  buffer[7] = record.time >> 24;
+  buffer[8] = 0;
+  for (uint8_t i = 1; i < 8; i++) buffer[8] ^= buffer[i];
+  Serial.write(buffer, 9);
+}
+
+
+void drain() {
+  // Sends the records in a batch, but only as long as they fit in Serial's transmit buffer.
+  // A text record needs at most 20 characters ("Feedback 128: 0x5A\r\n")
+  const int recordSize = (binaryOutput) ? 9 : 20;
+  while ((ringTail != ringHead) && (Serial.availableForWrite() >= recordSize)) {
+    if (binaryOutput) sendBinary(ring[ringTail % RING_SIZE]);
+    else sendText(ring[ringTail % RING_SIZE]);
+    ringTail++;
+  }
+}
+
+
+//*************************************** Sniffer ******************************************
+#if defined(SNIFFER)
+uint8_t feedback[128];                  // The 8 feedback bits of RS-bus address 1..128
+uint8_t nibblesSeen[128];               // Bit 0: low order nibble received, bit 1: high order nibble
+
+void sniff() {
+  // Bit layout of a RS-bus message (see RSbusConnection in RSbus.cpp): bit 7..4: data bits 0..3,
+  // bit 3: high (1) or low (0) order nibble, bit 2..1: the TT bits (10 or 01), bit 0: odd parity
+  while (SNIFFER.available()) {
+    uint8_t data = SNIFFER.read();
+    noInterrupts();
+    // As long as polling hasn't resumed, the polled address is still in isrCounter
+    uint8_t address = ((micros() - tLastPulse) > 1000) ? isrCounter - 1 : gapAddress;
+    interrupts();
+    uint8_t tt = (data >> 1) & 0b11;
+    if ((address < 1) || (address > 128) || (__builtin_parity(data) == 0) || (tt == 0b00) || (tt == 0b11)) {
+      capture(evBadByte, address, data);
+      continue;
+    }
+    uint8_t value = ((data >> 7) & 0b0001) | ((data >> 5) & 0b0010) | ((data >> 3) & 0b0100) | ((data >> 1) & 0b1000);
+    uint8_t index = address - 1;
+    uint8_t newState;
+    uint8_t seen;
+    if (data & 0b00001000) {newState = (feedback[index] & 0x0F) | (value << 4); seen = 0b10;}
+    else {newState = (feedback[index] & 0xF0) | value; seen = 0b01;}
+    if ((newState != feedback[index]) || !(nibblesSeen[index] & seen)) {
+      feedback[index] = newState;
+      nibblesSeen[index] |= seen;
+      capture(evFeedback, address, newState);
+    }
+  }
+}
+#endif
+
 //**************************************** Main *******************************************  
 void setup() {
   pinMode(ledPin, OUTPUT);
   attachInterrupt(digitalPinToInterrupt(RsBus_RX), rs_interrupt, RISING);
   Serial.begin(115200);
+  #if defined(SNIFFER)
+  SNIFFER.begin(4800);                  // RS-bus messages: 8 bit, no parity, 1 stop bit
+  #endif
   delay(500);
-  Serial.println("Start");
+  capture(evStart);
 }
 
     
@@ -90,7 +272,7 @@ void monitor() {
       case matchedFirst:
         if (addressPolled == previousAddressPolled) pollState = matchedSecond;
         else {
-          if (signalDetected) Serial.println(previousAddressPolled-1);
+          if (signalDetected) capture(evMessage, previousAddressPolled-1);
           pollState = polling;
           previousAddressPolled = addressPolled;
         }
@@ -98,7 +280,7 @@ void monitor() {
       case matchedSecond:
         if (addressPolled == previousAddressPolled) pollState = silence_4ms;
         else {
-          if (signalDetected) Serial.println(previousAddressPolled-1);
+          if (signalDetected) capture(evMessage, previousAddressPolled-1);
           pollState = polling;
           previousAddressPolled = addressPolled;
         }
@@ -106,10 +288,7 @@ void monitor() {
       case silence_4ms:
         if (addressPolled == previousAddressPolled) pollState = silence_5ms;
         else {
-          if (signalDetected) {
-            Serial.print("Double byte: ");
-            Serial.println(previousAddressPolled-1);
-          }
+          if (signalDetected) capture(evDoubleByte, previousAddressPolled-1);
           pollState = polling;
           previousAddressPolled = addressPolled;
         }
@@ -120,21 +299,16 @@ void monitor() {
           isrCounter = 0;
           previousAddressPolled = 0;
           if (addressPolled == 130) {
-            if (signalDetected == false) Serial.println("Signal detected");
+            if (signalDetected == false) capture(evSignalDetected);
+            else if (captureCycles) capture(evCycle, addressPolled);
             signalDetected = true;
           }
           else {
-            if (signalDetected) {
-              Serial.print("Count error: ");
-              Serial.println(addressPolled);  
-            }          
+            if (signalDetected) capture(evCountError, addressPolled);
           }
         }
         else {
-          if (signalDetected) {
-            Serial.print("Double byte: ");
-            Serial.println(previousAddressPolled-1);
-          }
+          if (signalDetected) capture(evDoubleByte, previousAddressPolled-1);
           pollState = polling;
           previousAddressPolled = addressPolled;
         }        
@@ -169,7 +343,7 @@ void monitor() {
         else {
           pollState = polling;
           previousAddressPolled = addressPolled;
-          if (signalDetected) Serial.println("Parity Error");
+          if (signalDetected) capture(evParityError);
         }
       break;
       case silence_11ms:
@@ -177,19 +351,19 @@ void monitor() {
         else {
           pollState = polling;
           previousAddressPolled = addressPolled;
-          if (signalDetected) Serial.println("Parity Error");
+          if (signalDetected) capture(evParityError);
         }
       break;
       case silence_12ms:
         if (addressPolled == 0) {
-          if (signalDetected) Serial.println("Signal lost");
+          if (signalDetected) capture(evSignalLost);
           pollState = signalLost;
           signalDetected = false;
         }
         else {
           pollState = polling;  
           previousAddressPolled = addressPolled;
-          if (signalDetected) Serial.println("Parity Error");
+          if (signalDetected) capture(evParityError);
         }
       break;
       case signalLost:
@@ -206,4 +380,9 @@ void loop() {
   else digitalWrite(ledPin, LOW);
   // State machine:
   monitor();
+  #if defined(SNIFFER)
+  sniff();
+  #endif
+  // Output of the captured events:
+  drain();
 }
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+#******************************************************************************************************
+#
+# Host decoder for the binary output of the RS-Bus monitor (Monitor.ino, binaryOutput = true).
+#
+# Every record is 9 bytes: 0xA5, type, value, data, time (4 bytes, ms, little endian) and a checksum,
+# which is the XOR of type, value, data and the four time bytes. Bytes that do not form a valid record (for example
+# if the capture started in the middle of a record) are skipped.
+# The output is the same text as the monitor prints in text mode, preceded by the time in ms.
+#
+# Usage:
+#   python3 monitor_decode.py capture.bin          decode a file holding a binary capture
+#   python3 monitor_decode.py /dev/ttyUSB0         decode live from a serial port (requires pyserial)
+#   python3 monitor_decode.py COM3 115200          idem, with an explicit baudrate (default 115200)
+#
+# 2026-10-14 / AG: Initial version, including sniffer records
+#
+#******************************************************************************************************
+import sys
+
+RECORD_SYNC = 0xA5
+RECORD_SIZE = 9
+
+EVENTS = [
+    "Start",            # evStart
+    "{}",               # evMessage: the address
+    "Double byte: {}",  # evDoubleByte
+    "Count error: {}",  # evCountError: the number of pulses
+    "Parity Error",     # evParityError
+    "Signal detected",  # evSignalDetected
+    "Signal lost",      # evSignalLost
+    "Overflow: {}",     # evOverflow: number of records lost
+    "Cycle",            # evCycle
+    "Feedback {}: 0x{:02X}",  # evFeedback: the address and its new feedback bits
+    "Bad byte {}: 0x{:02X}",  # evBadByte: the address and the byte received
+]
+
+
+def decode(data):
+    # Decodes as many records as possible. Returns the lines and the number of bytes consumed
+    lines = []
+    i = 0
+    while len(data) - i >= RECORD_SIZE:
+        if data[i] != RECORD_SYNC:
+            i += 1
+            continue
+        record = data[i:i + RECORD_SIZE]
+        checksum = 0
+        for byte in record[1:8]:
+            checksum ^= byte
+        if (checksum != record[8]) or (record[1] >= len(EVENTS)):
+            i += 1                      # Not a valid record: search for the next sync byte
+            continue
+        time = int.from_bytes(record[4:8], "little")
+        lines.append("{:10d} {}".format(time, EVENTS[record[1]].format(record[2], record[3])))
+        i += RECORD_SIZE
+    return lines, i
+
+
+def is_serial_port(name):
+    return name.startswith("/dev/") or name.upper().startswith("COM")
+
+
+def open_source(name, baudrate):
+    if is_serial_port(name):
+        import serial                   # pyserial
+        port = serial.Serial(name, baudrate, timeout=0.1)
+        return port.read
+    stream = open(name, "rb")
+    return stream.read
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: monitor_decode.py <file or serial port> [baudrate]")
+        sys.exit(1)
+    baudrate = int(sys.argv[2]) if len(sys.argv) > 2 else 115200
+    read = open_source(sys.argv[1], baudrate)
+    pending = b""
+    try:
+        while True:
+            chunk = read(4096)
+            if not chunk:
+                if is_serial_port(sys.argv[1]):
+                    continue            # Serial port: wait for more data
+                break                   # File: done
+            lines, used = decode(pending + chunk)
+            pending = (pending + chunk)[used:]
+            for line in lines:
+                print(line, flush=True)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,114 @@
+//******************************************************************************************************
+//
+// file:      Arduino.h
+// author:    Aiko Pras
+// history:   2026-10-14 V1.0 ag Initial version
+//
+// purpose:   Host (PC) replacement of the Arduino core, for the RS-bus simulator in extras/sim.
+//            Only what the library and its examples use is declared. Time is simulated: micros()
+//            and millis() return the simulated time (see sim.h), and attachInterrupt() stores the
+//            function that the simulated RS-bus pulses call.
+//
+//******************************************************************************************************
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <avr/io.h>
+
+#if defined(MOCK_XMEGA)
+#define F_CPU 24000000UL                // DxCore default
+#else
+#define F_CPU 16000000UL                // UNO, MEGA
+#endif
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define DEC 10
+#define HEX 16
+#define BIN 2
+#define A0 14
+#define PIN_PA0 0
+#define NUM_DIGITAL_PINS 20
+#define NOT_AN_INTERRUPT -1
+
+unsigned long micros(void);
+unsigned long millis(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void noInterrupts(void);
+void interrupts(void);
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+int digitalPinToInterrupt(uint8_t pin);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+long random(long max);
+void randomSeed(unsigned long seed);
+
+// An ISR is a normal function, that the simulator calls
+#define ISR(vector) extern "C" void vector(void); extern "C" void vector(void)
+#define sei()
+#define cli()
+
+// All pins are on a single port: the pin change interrupt of PCINT0_vect
+#define digitalPinToPort(p) (p)
+#define digitalPinToBitMask(p) (1 << ((p) & 7))
+#if defined(MOCK_XMEGA)
+#define portInputRegister(p) (&VPORTA.IN)
+#define portOutputRegister(p) (&VPORTA.OUT)
+#else
+#define portInputRegister(p) (&PINB)
+#define portOutputRegister(p) (&PORTD)
+#define digitalPinToPCICR(p) (&PCICR)
+#define digitalPinToPCICRbit(p) (0)
+#define digitalPinToPCMSK(p) (&PCMSK0)
+#define digitalPinToPCMSKbit(p) ((p) & 7)
+#endif
+
+#define PROGMEM
+#define pgm_read_byte(a) (*(const uint8_t *)(a))
+#define pgm_read_word(a) (*(const uint16_t *)(a))
+#define F(s) s
+
+class Print {
+  public:
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+    size_t println(const char *s = "");
+    size_t println(int value, int base = DEC);
+    size_t println(unsigned int value, int base = DEC);
+    size_t println(long value, int base = DEC);
+    size_t println(unsigned long value, int base = DEC);
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+};
+
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long baud);
+    int available(void);
+    int read(void);
+    int availableForWrite(void);
+    void flush(void);
+    operator bool() {return true;}
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
@@ -0,0 +1,10 @@
+// Host replacement of the Arduino EEPROM library, for the RS-bus simulator in extras/sim
+#pragma once
+#include <stdint.h>
+
+struct EEPROMClass {
+  uint8_t read(int address);
+  void update(int address, uint8_t value);
+};
+
+extern EEPROMClass EEPROM;
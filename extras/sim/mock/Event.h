@@ -0,0 +1,19 @@
+// Host replacement of the Event library of DxCore and MegaCoreX, for the RS-bus simulator in extras/sim.
+// The event channels are not simulated: the simulator calls the ISRs of the TCB and TCA directly.
+#pragma once
+#include <stdint.h>
+
+namespace user {
+  enum user_t {
+    tcb0_capt, tcb1_capt, tcb2_capt, tcb3_capt, tcb4_capt,
+    tcb0_cnt, tcb1_cnt, tcb2_cnt, tcb3_cnt, tcb4_cnt,
+    tca0_cnta, tca1_cnta, tca0_cnt, tca1_cnt, tca0, tca0_cnt_a
+  };
+}
+
+class Event {
+  public:
+    static Event &assign_generator_pin(uint8_t pin);
+    void set_user(user::user_t user);
+    void start(void);
+};
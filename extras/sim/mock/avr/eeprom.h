@@ -0,0 +1,6 @@
+// Host replacement, for the RS-bus simulator in extras/sim
+#pragma once
+#include <stdint.h>
+
+uint8_t eeprom_read_byte(const uint8_t *address);
+void eeprom_update_byte(uint8_t *address, uint8_t value);
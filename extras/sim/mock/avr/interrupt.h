@@ -0,0 +1,2 @@
+// Host replacement, for the RS-bus simulator in extras/sim. ISR() is defined in Arduino.h
+#pragma once
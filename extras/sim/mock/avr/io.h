@@ -0,0 +1,385 @@
+//******************************************************************************************************
+//
+// file:      io.h
+// author:    Aiko Pras
+// history:   2026-10-14 V1.0 ag Initial version
+//
+// purpose:   Host (PC) replacement of <avr/io.h>, for the RS-bus simulator in extras/sim.
+//            The registers are normal variables. The simulator (sim_bus.cpp) writes the registers that
+//            the hardware would change, such as the counters and interrupt flags, and calls the ISR.
+//            Only the registers and bit names used by the RS-bus library are present.
+//            - Default: a traditional ATMega (2560)
+//            - MOCK_XMEGA: MegaCoreX (4809), or with MOCK_DA as well: DxCore (AVR128DA)
+//
+//            Registers are declared via MOCK_REG. mock_avr.cpp redefines MOCK_REG to define them.
+//            The register names are also defined as macro, since the library tests with #if defined()
+//            which registers a processor has.
+//
+//******************************************************************************************************
+#pragma once
+#include <stdint.h>
+
+#if !defined(MOCK_REG)
+#define MOCK_REG(type, name) extern type name;
+#endif
+
+#define __AVR__ 1
+MOCK_REG(volatile uint8_t, SREG)
+
+
+#if defined(MOCK_XMEGA)
+//******************************************************************************************************
+// MegaCoreX and DxCore
+//******************************************************************************************************
+#define __AVR_XMEGA__ 1
+#if defined(MOCK_DA)
+#define __AVR_DA__ 1
+#else
+#define MEGACOREX 1
+#endif
+
+// RTC (including the PIT)
+typedef struct {
+  volatile uint8_t CTRLA, STATUS, INTCTRL, INTFLAGS, TEMP, DBGCTRL, CALIB, CLKSEL;
+  volatile uint16_t CNT, PER, CMP;
+  volatile uint8_t PITCTRLA, PITSTATUS, PITINTCTRL, PITINTFLAGS, PITDBGCTRL;
+} RTC_t;
+MOCK_REG(RTC_t, RTC_registers)
+#define RTC RTC_registers
+#define RTC_OVF_bm 0x01
+#define RTC_CMP_bm 0x02
+#define RTC_RTCEN_bm 0x01
+#define RTC_PITEN_bm 0x01
+#define RTC_PI_bm 0x01
+#define RTC_PITCTRLABUSY_bm 0x01
+#define RTC_CLKSEL_INT32K_gc 0x00
+#define RTC_CLKSEL_EXTCLK_gc 0x03
+#define RTC_PRESCALER_DIV1_gc 0x00
+#define RTC_PERIOD_CYC32_gc (0x04 << 3)
+#define RTC_PERIOD_CYC64_gc (0x05 << 3)
+
+// TCB0..TCB4
+typedef struct {
+  volatile uint8_t CTRLA, CTRLB, EVCTRL, INTCTRL, INTFLAGS, STATUS, DBGCTRL, TEMP;
+  volatile uint16_t CNT, CCMP;
+} TCB_t;
+MOCK_REG(TCB_t, TCB0)
+MOCK_REG(TCB_t, TCB1)
+MOCK_REG(TCB_t, TCB2)
+MOCK_REG(TCB_t, TCB3)
+MOCK_REG(TCB_t, TCB4)
+#define TCB0 TCB0
+#define TCB1 TCB1
+#define TCB2 TCB2
+#define TCB3 TCB3
+#define TCB4 TCB4
+#define TCB0_CNT TCB0.CNT
+#define TCB1_CNT TCB1.CNT
+#define TCB2_CNT TCB2.CNT
+#define TCB3_CNT TCB3.CNT
+#define TCB4_CNT TCB4.CNT
+#define TCB0_CCMP TCB0.CCMP
+#define TCB1_CCMP TCB1.CCMP
+#define TCB2_CCMP TCB2.CCMP
+#define TCB3_CCMP TCB3.CCMP
+#define TCB4_CCMP TCB4.CCMP
+#define TCB0_EVCTRL TCB0.EVCTRL
+#define TCB1_EVCTRL TCB1.EVCTRL
+#define TCB2_EVCTRL TCB2.EVCTRL
+#define TCB3_EVCTRL TCB3.EVCTRL
+#define TCB4_EVCTRL TCB4.EVCTRL
+#define TCB0_INTFLAGS TCB0.INTFLAGS
+#define TCB1_INTFLAGS TCB1.INTFLAGS
+#define TCB2_INTFLAGS TCB2.INTFLAGS
+#define TCB3_INTFLAGS TCB3.INTFLAGS
+#define TCB4_INTFLAGS TCB4.INTFLAGS
+#define TCB_ENABLE_bm 0x01
+#define TCB_RUNSTDBY_bm 0x40
+#define TCB_CAPTEI_bm 0x01
+#define TCB_EDGE_bm 0x10
+#define TCB_FILTER_bm 0x40
+#define TCB_CAPT_bm 0x01
+#define TCB_CLKSEL_CLKDIV1_gc 0x00
+#define TCB_CLKSEL_CLKDIV2_gc 0x02
+#define TCB_CLKSEL_EVENT_gc 0x0E
+#define TCB_CNTMODE_INT_gc 0x00
+#define TCB_CNTMODE_FRQ_gc 0x03
+
+// TCA0, in single (16 bit) mode
+typedef struct {
+  volatile uint8_t CTRLA, CTRLB, CTRLC, CTRLD, CTRLECLR, CTRLESET, CTRLFCLR, CTRLFSET;
+  volatile uint8_t EVCTRL, INTCTRL, INTFLAGS, DBGCTRL, TEMP;
+  volatile uint16_t CNT, PER, CMP0, CMP1, CMP2;
+} TCA_SINGLE_t;
+typedef union {TCA_SINGLE_t SINGLE;} TCA_t;
+MOCK_REG(TCA_t, TCA0)
+#define TCA0 TCA0
+#define TCA_SINGLE_ENABLE_bm 0x01
+#define TCA_SINGLE_CLKSEL_DIV1_gc 0x00
+#define TCA_SINGLE_WGMODE_NORMAL_gc 0x00
+#define TCA_SINGLE_EVACT_POSEDGE_gc 0x00
+#define TCA_SINGLE_EVACTA_CNT_POSEDGE_gc 0x00
+#define TCA_SINGLE_OVF_bm 0x01
+#define TCA_SINGLE_CMP0_bm 0x10
+#define TCA_SINGLE_CMD_RESTART_gc 0x08
+#define TCA_SINGLE_CMD_RESET_gc 0x0C
+#if defined(MOCK_DA)
+#define TCA_SINGLE_CNTAEI_bm 0x01
+#else
+#define TCA_SINGLE_CNTEI_bm 0x01
+#endif
+
+// USART0..USART5
+typedef struct {
+  volatile uint8_t RXDATAL, RXDATAH, TXDATAL, TXDATAH, STATUS, CTRLA, CTRLB, CTRLC;
+  volatile uint16_t BAUD;
+} USART_t;
+MOCK_REG(USART_t, USART0)
+MOCK_REG(USART_t, USART1)
+MOCK_REG(USART_t, USART2)
+MOCK_REG(USART_t, USART3)
+MOCK_REG(USART_t, USART4)
+MOCK_REG(USART_t, USART5)
+#define USART0 USART0
+#define USART1 USART1
+#define USART2 USART2
+#define USART3 USART3
+#define USART4 USART4
+#define USART5 USART5
+#define USART_PERR_bm 0x02
+#define USART_FERR_bm 0x04
+#define USART_TXEN_bm 0x40
+#define USART_RXEN_bm 0x80
+#define USART_RXCIE_bm 0x80
+#define USART_RXCIF_bm 0x80
+
+// PORTMUX
+typedef struct {volatile uint8_t USARTROUTEA, USARTROUTEB, TCAROUTEA, TCBROUTEA;} PORTMUX_t;
+MOCK_REG(PORTMUX_t, PORTMUX)
+#define PORTMUX_USART0_gm 0x03
+#define PORTMUX_USART1_gm 0x0C
+#define PORTMUX_USART2_gm 0x30
+#define PORTMUX_USART3_gm 0xC0
+#define PORTMUX_USART4_gm 0x03
+#define PORTMUX_USART5_gm 0x0C
+#define PORTMUX_USART00_bm 0x01
+#define PORTMUX_USART10_bm 0x04
+#define PORTMUX_USART20_bm 0x10
+#define PORTMUX_USART30_bm 0x40
+#define PORTMUX_USART40_bm 0x01
+#define PORTMUX_USART50_bm 0x04
+
+// Ports
+typedef struct {
+  volatile uint8_t DIR, DIRSET, DIRCLR, DIRTGL, OUT, OUTSET, OUTCLR, OUTTGL, IN, INTFLAGS;
+  volatile uint8_t PIN0CTRL, PIN1CTRL;
+} PORT_t;
+typedef struct {volatile uint8_t DIR, OUT, IN, INTFLAGS;} VPORT_t;
+MOCK_REG(PORT_t, PORTA)
+MOCK_REG(PORT_t, PORTB)
+MOCK_REG(PORT_t, PORTC)
+MOCK_REG(PORT_t, PORTD)
+MOCK_REG(PORT_t, PORTE)
+MOCK_REG(PORT_t, PORTF)
+MOCK_REG(PORT_t, PORTG)
+MOCK_REG(VPORT_t, VPORTA)
+MOCK_REG(VPORT_t, VPORTB)
+MOCK_REG(VPORT_t, VPORTC)
+MOCK_REG(VPORT_t, VPORTD)
+MOCK_REG(VPORT_t, VPORTE)
+MOCK_REG(VPORT_t, VPORTF)
+#define PIN0_bm 0x01
+#define PIN4_bm 0x10
+#define PORT_INVEN_bm 0x80
+
+
+#else
+//******************************************************************************************************
+// Traditional ATMega processors (2560)
+//******************************************************************************************************
+#define __AVR_MEGA__ 1
+#define __AVR_ATmega2560__ 1
+
+// Timers
+MOCK_REG(volatile uint8_t, TCNT0)
+MOCK_REG(volatile uint8_t, TCCR1A)
+MOCK_REG(volatile uint8_t, TCCR1B)
+MOCK_REG(volatile uint16_t, TCNT1)
+MOCK_REG(volatile uint16_t, OCR1A)
+MOCK_REG(volatile uint8_t, TIMSK1)
+MOCK_REG(volatile uint8_t, TIFR1)
+MOCK_REG(volatile uint8_t, TCCR2A)
+MOCK_REG(volatile uint8_t, TCCR2B)
+MOCK_REG(volatile uint8_t, TCNT2)
+MOCK_REG(volatile uint8_t, OCR2A)
+MOCK_REG(volatile uint8_t, TIMSK2)
+MOCK_REG(volatile uint8_t, TCCR3A)
+MOCK_REG(volatile uint8_t, TCCR3B)
+MOCK_REG(volatile uint16_t, TCNT3)
+MOCK_REG(volatile uint16_t, OCR3A)
+MOCK_REG(volatile uint8_t, TIMSK3)
+MOCK_REG(volatile uint8_t, TIFR3)
+MOCK_REG(volatile uint8_t, TCCR4A)
+MOCK_REG(volatile uint8_t, TCCR4B)
+MOCK_REG(volatile uint16_t, TCNT4)
+MOCK_REG(volatile uint16_t, OCR4A)
+MOCK_REG(volatile uint8_t, TIMSK4)
+MOCK_REG(volatile uint8_t, TIFR4)
+MOCK_REG(volatile uint8_t, TCCR5A)
+MOCK_REG(volatile uint8_t, TCCR5B)
+MOCK_REG(volatile uint16_t, TCNT5)
+MOCK_REG(volatile uint16_t, OCR5A)
+MOCK_REG(volatile uint8_t, TIMSK5)
+MOCK_REG(volatile uint8_t, TIFR5)
+#define TCNT0 TCNT0
+#define TCCR1A TCCR1A
+#define TCCR1B TCCR1B
+#define TCNT1 TCNT1
+#define OCR1A OCR1A
+#define TIMSK1 TIMSK1
+#define TIFR1 TIFR1
+#define TCCR2A TCCR2A
+#define TCCR2B TCCR2B
+#define TCNT2 TCNT2
+#define OCR2A OCR2A
+#define TIMSK2 TIMSK2
+#define TCCR3A TCCR3A
+#define TCCR3B TCCR3B
+#define TCNT3 TCNT3
+#define OCR3A OCR3A
+#define TIMSK3 TIMSK3
+#define TIFR3 TIFR3
+#define TCCR4A TCCR4A
+#define TCCR4B TCCR4B
+#define TCNT4 TCNT4
+#define OCR4A OCR4A
+#define TIMSK4 TIMSK4
+#define TIFR4 TIFR4
+#define TCCR5A TCCR5A
+#define TCCR5B TCCR5B
+#define TCNT5 TCNT5
+#define OCR5A OCR5A
+#define TIMSK5 TIMSK5
+#define TIFR5 TIFR5
+#define TOIE1 0
+#define TOV1 0
+#define OCIE1A 1
+#define OCF1A 1
+#define OCIE3A 1
+#define OCF3A 1
+#define OCIE4A 1
+#define OCF4A 1
+#define OCIE5A 1
+#define OCF5A 1
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+
+// USART0..USART3
+MOCK_REG(volatile uint8_t, UDR0)
+MOCK_REG(volatile uint8_t, UCSR0A)
+MOCK_REG(volatile uint8_t, UCSR0B)
+MOCK_REG(volatile uint8_t, UCSR0C)
+MOCK_REG(volatile uint8_t, UBRR0L)
+MOCK_REG(volatile uint8_t, UBRR0H)
+MOCK_REG(volatile uint8_t, UDR1)
+MOCK_REG(volatile uint8_t, UCSR1A)
+MOCK_REG(volatile uint8_t, UCSR1B)
+MOCK_REG(volatile uint8_t, UCSR1C)
+MOCK_REG(volatile uint8_t, UBRR1L)
+MOCK_REG(volatile uint8_t, UBRR1H)
+MOCK_REG(volatile uint8_t, UDR2)
+MOCK_REG(volatile uint8_t, UCSR2A)
+MOCK_REG(volatile uint8_t, UCSR2B)
+MOCK_REG(volatile uint8_t, UCSR2C)
+MOCK_REG(volatile uint8_t, UBRR2L)
+MOCK_REG(volatile uint8_t, UBRR2H)
+MOCK_REG(volatile uint8_t, UDR3)
+MOCK_REG(volatile uint8_t, UCSR3A)
+MOCK_REG(volatile uint8_t, UCSR3B)
+MOCK_REG(volatile uint8_t, UCSR3C)
+MOCK_REG(volatile uint8_t, UBRR3L)
+MOCK_REG(volatile uint8_t, UBRR3H)
+#define UDR0 UDR0
+#define UCSR0A UCSR0A
+#define UCSR0B UCSR0B
+#define UCSR0C UCSR0C
+#define UBRR0L UBRR0L
+#define UBRR0H UBRR0H
+#define UDR1 UDR1
+#define UCSR1A UCSR1A
+#define UCSR1B UCSR1B
+#define UCSR1C UCSR1C
+#define UBRR1L UBRR1L
+#define UBRR1H UBRR1H
+#define UDR2 UDR2
+#define UCSR2A UCSR2A
+#define UCSR2B UCSR2B
+#define UCSR2C UCSR2C
+#define UBRR2L UBRR2L
+#define UBRR2H UBRR2H
+#define UDR3 UDR3
+#define UCSR3A UCSR3A
+#define UCSR3B UCSR3B
+#define UCSR3C UCSR3C
+#define UBRR3L UBRR3L
+#define UBRR3H UBRR3H
+#define TXEN0 3
+#define TXEN1 3
+#define TXEN2 3
+#define TXEN3 3
+#define RXEN0 4
+#define RXEN1 4
+#define RXCIE0 7
+#define RXCIE1 7
+#define UPE0 2
+#define UPE1 2
+#define FE0 4
+#define FE1 4
+#define UCSZ00 1
+#define UCSZ01 2
+#define UCSZ10 1
+#define UCSZ11 2
+#define UCSZ20 1
+#define UCSZ21 2
+#define UCSZ30 1
+#define UCSZ31 2
+
+// External and pin change interrupts, ports
+MOCK_REG(volatile uint8_t, EICRA)
+MOCK_REG(volatile uint8_t, EICRB)
+MOCK_REG(volatile uint8_t, EIMSK)
+MOCK_REG(volatile uint8_t, PCICR)
+MOCK_REG(volatile uint8_t, PCIFR)
+MOCK_REG(volatile uint8_t, PCMSK0)
+MOCK_REG(volatile uint8_t, PCMSK1)
+MOCK_REG(volatile uint8_t, PCMSK2)
+MOCK_REG(volatile uint8_t, PINB)
+MOCK_REG(volatile uint8_t, PIND)
+MOCK_REG(volatile uint8_t, PORTD)
+#define EICRA EICRA
+#define EICRB EICRB
+#define EIMSK EIMSK
+#define PCICR PCICR
+#define PCIFR PCIFR
+#define PCMSK0 PCMSK0
+#define PCMSK1 PCMSK1
+#define PCMSK2 PCMSK2
+#define PINB PINB
+#define PIND PIND
+#define PORTD PORTD
+#define ISC00 0
+#define ISC01 1
+#define ISC10 2
+#define ISC11 3
+#define INT0 0
+#define INT1 1
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCINT0_vect PCINT0_vect
+#define PCINT1_vect PCINT1_vect
+#define PCINT2_vect PCINT2_vect
+
+#endif
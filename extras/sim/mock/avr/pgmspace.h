@@ -0,0 +1,2 @@
+// Host replacement, for the RS-bus simulator in extras/sim. PROGMEM and pgm_read_*() are in Arduino.h
+#pragma once
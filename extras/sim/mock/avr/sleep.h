@@ -0,0 +1,5 @@
+// Host replacement, for the RS-bus simulator in extras/sim
+#pragma once
+#define SLEEP_MODE_IDLE 0
+inline void set_sleep_mode(int) {}
+inline void sleep_mode(void) {}
@@ -0,0 +1,78 @@
+//******************************************************************************************************
+//
+// file:      mock_avr.cpp
+// author:    Aiko Pras
+// history:   2026-10-14 V1.0 ag Initial version
+//
+// purpose:   Host (PC) replacement of the Arduino core and the AVR registers, for the RS-bus
+//            simulator in extras/sim. Defines the registers declared in avr/io.h, the simulated time
+//            and the Arduino functions the library calls.
+//
+//******************************************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#define MOCK_REG(type, name) type name;
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <avr/eeprom.h>
+#if defined(MOCK_XMEGA)
+#include <Event.h>
+#endif
+
+unsigned long simTime = 0;               // Simulated time (us), advanced by the simulator
+void (*pinIsr)(void) = 0;                // The function given to attachInterrupt()
+
+unsigned long micros(void) {return simTime;}
+unsigned long millis(void) {return simTime / 1000;}
+void delay(unsigned long) {}
+void delayMicroseconds(unsigned int) {}
+void noInterrupts(void) {}
+void interrupts(void) {}
+void attachInterrupt(uint8_t, void (*isr)(void), int) {pinIsr = isr;}
+void detachInterrupt(uint8_t) {pinIsr = 0;}
+int digitalPinToInterrupt(uint8_t pin) {return pin;}
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+int digitalRead(uint8_t) {return 0;}
+int analogRead(uint8_t) {return 0;}
+long random(long max) {return (max > 0) ? (rand() % max) : 0;}
+void randomSeed(unsigned long seed) {srand(seed);}
+
+// EEPROM: 4K bytes, as on the 2560
+static uint8_t eepromCells[4096];
+uint8_t eeprom_read_byte(const uint8_t *address) {return eepromCells[(uintptr_t) address & 0x0FFF];}
+void eeprom_update_byte(uint8_t *address, uint8_t value) {eepromCells[(uintptr_t) address & 0x0FFF] = value;}
+uint8_t EEPROMClass::read(int address) {return eepromCells[address & 0x0FFF];}
+void EEPROMClass::update(int address, uint8_t value) {eepromCells[address & 0x0FFF] = value;}
+EEPROMClass EEPROM;
+
+#if defined(MOCK_XMEGA)
+// The event channels are not simulated
+static Event eventChannel;
+Event &Event::assign_generator_pin(uint8_t) {return eventChannel;}
+void Event::set_user(user::user_t) {}
+void Event::start(void) {}
+#endif
+
+// Serial writes to stdout
+size_t Print::print(const char *s) {return printf("%s", s);}
+size_t Print::print(char c) {return printf("%c", c);}
+size_t Print::print(int value, int base) {return (base == HEX) ? printf("%X", value) : printf("%d", value);}
+size_t Print::print(unsigned int value, int base) {return (base == HEX) ? printf("%X", value) : printf("%u", value);}
+size_t Print::print(long value, int base) {return (base == HEX) ? printf("%lX", value) : printf("%ld", value);}
+size_t Print::print(unsigned long value, int base) {return (base == HEX) ? printf("%lX", value) : printf("%lu", value);}
+size_t Print::print(double value, int digits) {return printf("%.*f", digits, value);}
+size_t Print::println(const char *s) {return printf("%s\n", s);}
+size_t Print::println(int value, int base) {return print(value, base) + printf("\n");}
+size_t Print::println(unsigned int value, int base) {return print(value, base) + printf("\n");}
+size_t Print::println(long value, int base) {return print(value, base) + printf("\n");}
+size_t Print::println(unsigned long value, int base) {return print(value, base) + printf("\n");}
+size_t Print::write(uint8_t c) {return (putchar(c) == EOF) ? 0 : 1;}
+size_t Print::write(const uint8_t *buffer, size_t size) {return fwrite(buffer, 1, size, stdout);}
+void HardwareSerial::begin(unsigned long) {}
+int HardwareSerial::available(void) {return 0;}
+int HardwareSerial::read(void) {return -1;}
+int HardwareSerial::availableForWrite(void) {return 64;}
+void HardwareSerial::flush(void) {}
+HardwareSerial Serial;
+HardwareSerial Serial1;
@@ -0,0 +1,6 @@
+// Host replacement, for the RS-bus simulator in extras/sim. The simulated ISRs never preempt
+#pragma once
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 1
+#define ATOMIC_BLOCK(type) for (int atomicOnce = 1; atomicOnce; atomicOnce = 0)
+#define NONATOMIC_BLOCK(type) for (int atomicOnce = 1; atomicOnce; atomicOnce = 0)
@@ -0,0 +1,3 @@
+// Host replacement, for the RS-bus simulator in extras/sim
+#pragma once
+#define parity_even_bit(value) (__builtin_parity(value))
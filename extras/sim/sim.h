@@ -0,0 +1,105 @@
+//******************************************************************************************************
+//
+// file:      sim.h
+// author:    Aiko Pras
+// history:   2026-10-14 V1.0 ag Initial version
+//
+// purpose:   Host (PC) simulator of the RS-bus, to test the library without hardware.
+//            The library sources in src/ are compiled for the PC, against the mock registers in
+//            extras/sim/mock. The simulator replaces the hardware on both sides of the decoder:
+//            - CommandStation: the master. Generates pulse trains, including errors, receives the
+//              bytes the decoder writes to the USART, and checks their parity and contents
+//            - BusInput: the decoder's receiver hardware. Feeds each pulse into the counters, capture
+//              registers or pin interrupt that the selected variant (RSBUS_USES_...) uses, and calls
+//              its ISR just like the hardware would
+//            Time is simulated: the decoder's main loop runs every LOOP_TIME microseconds, and the
+//            silence timers (SW_Tx, RSBUS_SILENCE_...) fire every 2ms.
+//            The scenarios in sim_main.cpp build on these classes. See README.md for details.
+//
+//******************************************************************************************************
+#pragma once
+#include <Arduino.h>
+#include "RSbus.h"
+
+extern unsigned long simTime;          // Simulated time (us). See mock/mock_avr.cpp
+extern RSbusHardware rsbusHardware;    // Defined in RSbus.cpp
+
+
+//******************************************************************************************************
+// Timing of the RS-bus signal, the same as in examples/CommandStation_Simulator
+const uint16_t T_PULSE   = 203;        // Period of a pulse: 113us high, 90us low
+const uint16_t T_BYTE    = 2100;       // The master waits for a message, at 4800 baud, plus margin (us)
+const uint16_t T_SILENCE = 7000;       // Normal period of silence after a pulse train (us)
+const uint16_t T_PARITY  = 10700;      // Silence after a parity error (us)
+const uint16_t T_LOSS    = 20000;      // Silence that a decoder should see as signal loss (us)
+const uint8_t  PULSES    = 130;        // Pulses per pulse train. Address A is polled by pulse A+1
+const uint8_t  LOOP_TIME = 50;         // Time between two runs of the decoder's main loop (us)
+const uint8_t  SIM_BUSES = RSBUS_BUSES;
+
+
+//******************************************************************************************************
+// BusInput (sim_bus.cpp): the receiver hardware of the decoder, for one RS-bus
+class BusInput {
+  public:
+    BusInput(uint8_t bus = 0);
+    uint8_t pulse(bool lateIsr, bool glitch); // The rising edge of a pulse. Returns the pulses used
+    void spike(void);                  // A noise edge, now
+    volatile uint8_t *txData = 0;      // The USART data register of this bus
+    bool written;                      // The ISR wrote a byte to the USART at the latest edge
+    uint8_t data;                      // That byte
+
+    static const bool detectsLateIsr;  // The variant keeps a nibble if its ISR runs too late
+    static const bool rejectsNoise;    // The variant ignores extra edges (SW_TCBx)
+
+  private:
+    uint8_t bus;
+    unsigned long lastEdge = 0;        // Time of the previous (accepted or noise) edge
+    uint8_t writeLag = 0;              // RTC: pulses that are lost while a CNT write synchronises
+    uint16_t cntSeen = 0;              // RTC: CNT, as left by the previous pulse
+    void interrupt(void);              // Calls the ISR of the pulse input
+    uint32_t nibblesSent(void);        // Nibbles written by the ISR of this bus
+};
+
+void simTimers(void);                  // Called every LOOP_TIME. Fires the silence timer ISR
+
+
+//******************************************************************************************************
+// CommandStation (sim_master.cpp): the RS-bus master, for all buses
+struct Cycle {                         // One polling cycle, possibly with errors injected
+  uint8_t pulses = PULSES;             // Other than 130: a pulse count error
+  uint8_t spikeAddress = 0;            // A noise edge, 20us after the pulse that polls this address
+  uint8_t lateAddress = 0;             // Bus 0: the next pulse comes before the ISR of this address runs
+  uint8_t glitchAddress = 0;           // Bus 0, SW_TCBx: noise, captured while the ISR of this address runs
+  bool parityError = false;            // The bytes of this cycle (if any) are received with a parity error
+  uint16_t silence = T_SILENCE;        // Silence after the pulse train. T_LOSS: signal loss
+  uint8_t silentBuses = 0;             // Bit mask of the buses that get no pulses in this cycle
+};
+
+typedef void (*MainLoop)(void);
+
+RSbusHardware &simHardware(uint8_t bus);  // rsbusHardware, rsbusHardware1 or rsbusHardware2
+
+class CommandStation {
+  public:
+    CommandStation(MainLoop decoderLoop);  // decoderLoop: the loop() of the decoder's sketch
+    void attach(uint8_t bus, uint8_t usartNumber, uint8_t rxPin); // Calls attach() of the decoder
+    void wait(unsigned long time);     // Time passes (us), the decoder's main loop keeps running
+    void cycle(const Cycle &cycle);    // A pulse train followed by silence
+    void cycles(uint16_t number);      // Cycles without errors
+    bool knows(uint8_t address, uint8_t value, uint8_t bus = 0); // Has received both nibbles of value
+
+    uint32_t cycleCount = 0;           // Polling cycles generated
+    uint32_t badBytes = 0;             // Bytes with an incorrect parity or TT bits
+    uint32_t strayBytes = 0;           // Bytes after pulse 1 or after pulse 130 (no address)
+    uint32_t parityErrors = 0;         // Cycles followed by the longer silence of a parity error
+    uint32_t bytes[SIM_BUSES][129] = {};        // Bytes received, per address
+    unsigned long lastByte[SIM_BUSES][129] = {}; // Time of the latest byte, per address
+
+  private:
+    MainLoop decoderLoop;
+    BusInput input[SIM_BUSES];
+    uint8_t feedback[SIM_BUSES][129] = {};     // The 8 feedback bits of each address, as received
+    uint8_t nibblesSeen[SIM_BUSES][129] = {};  // Bit 0: low order nibble received, bit 1: high order
+    bool parityError = false;          // A bad byte was received: the master signals a parity error
+    void receive(uint8_t bus, uint8_t address, uint8_t data);
+};
@@ -0,0 +1,316 @@
+//******************************************************************************************************
+//
+// file:      sim_bus.cpp
+// author:    Aiko Pras
+// history:   2026-10-14 V1.0 ag Initial version
+//
+// purpose:   RS-bus simulator: the receiver hardware of the decoder (see sim.h).
+//            For each variant, pulse() does what the hardware does at the rising edge of a RS-bus
+//            pulse: it updates the counter, capture or pin registers, and calls the ISR if the hardware
+//            would raise an interrupt. A late ISR is simulated by counting the next pulse before the
+//            ISR is called, which is what happens if other interrupts delay the RS-bus ISR.
+//
+//******************************************************************************************************
+#include "sim.h"
+#include "sup_isr.h"
+
+extern volatile RSbusIsr rsISR;        // instantiated in "RS-bus.cpp"
+#if (RSBUS_BUSES > 1)
+extern volatile RSbusIsr rsISR1;
+#endif
+#if (RSBUS_BUSES > 2)
+extern volatile RSbusIsr rsISR2;
+#endif
+
+#define SIM_CAT3(a, b, c) a##b##c
+#define SIM_XCAT3(a, b, c) SIM_CAT3(a, b, c)
+const uint8_t TICKS_PER_US = F_CPU / 1000000;
+
+
+//******************************************************************************************************
+// The pulse input of each variant
+//******************************************************************************************************
+#if defined(RSBUS_USES_SW) || defined(RSBUS_USES_SW_4MS) || defined(RSBUS_USES_SW_T1) || \
+    defined(RSBUS_USES_SW_T3) || defined(RSBUS_USES_SW_T4) || defined(RSBUS_USES_SW_T5)
+  // The pin interrupt, or the pin change interrupt, calls the ISR at every pulse.
+  // The ISR can't tell if it runs late.
+  #define SIM_PIN_ISR
+  #if defined(RSBUS_SW_PCINT)
+  extern "C" void PCINT0_vect(void);
+  #else
+  extern void (*pinIsr)(void);         // See mock/mock_avr.cpp
+  #endif
+  const bool BusInput::detectsLateIsr = false;
+  const bool BusInput::rejectsNoise = false;
+#elif defined(RSBUS_BUS0_TCB)
+  // SW_TCBx: the TCB captures the time since the previous edge (in CCMP) and restarts counting. CNT
+  // holds the time since the latest edge. Edges that come too quickly are rejected as noise.
+  #define SIM_SW_TCB
+  extern "C" void SIM_XCAT3(TCB, RSBUS_BUS0_TCB, _INT_vect)(void);
+  #if (RSBUS_BUSES > 1)
+  extern "C" void SIM_XCAT3(TCB, RSBUS_BUS1_TCB, _INT_vect)(void);
+  #endif
+  #if (RSBUS_BUSES > 2)
+  extern "C" void SIM_XCAT3(TCB, RSBUS_BUS2_TCB, _INT_vect)(void);
+  #endif
+  const bool BusInput::detectsLateIsr = true;
+  const bool BusInput::rejectsNoise = true;
+#elif defined(RSBUS_USES_HW_TCB0) || defined(RSBUS_USES_HW_TCB1) || defined(RSBUS_USES_HW_TCB2) || \
+      defined(RSBUS_USES_HW_TCB3) || defined(RSBUS_USES_HW_TCB4)
+  // HW_TCBx: the TCB counts pulses. If CNT equals CCMP, the next pulse clears CNT and raises CAPT
+  #define SIM_HW_TCB
+  #if defined(RSBUS_USES_HW_TCB0)
+    #define SIM_TIMER TCB0
+    #define SIM_VECTOR TCB0_INT_vect
+  #elif defined(RSBUS_USES_HW_TCB1)
+    #define SIM_TIMER TCB1
+    #define SIM_VECTOR TCB1_INT_vect
+  #elif defined(RSBUS_USES_HW_TCB2)
+    #define SIM_TIMER TCB2
+    #define SIM_VECTOR TCB2_INT_vect
+  #elif defined(RSBUS_USES_HW_TCB3)
+    #define SIM_TIMER TCB3
+    #define SIM_VECTOR TCB3_INT_vect
+  #else
+    #define SIM_TIMER TCB4
+    #define SIM_VECTOR TCB4_INT_vect
+  #endif
+  extern "C" void SIM_VECTOR(void);
+  const bool BusInput::detectsLateIsr = true;
+  const bool BusInput::rejectsNoise = false;
+#elif defined(RSBUS_USES_HW_TCA0)
+  // HW_TCA0: TCA0 counts pulses. The compare flag is set when CNT becomes CMP0
+  #define SIM_HW_TCA
+  extern "C" void TCA0_CMP0_vect(void);
+  const bool BusInput::detectsLateIsr = true;
+  const bool BusInput::rejectsNoise = false;
+#elif defined(RSBUS_USES_HW_T1) || defined(RSBUS_USES_HW_T3) || defined(RSBUS_USES_HW_T4) || \
+      defined(RSBUS_USES_HW_T5)
+  // HW_Tx: Timer x counts pulses. If TCNTx equals OCRxA, OCFxA is set at the next pulse
+  #define SIM_HW_TX
+  #if defined(RSBUS_USES_HW_T1)
+    #define SIM_TCNT TCNT1
+    #define SIM_OCR OCR1A
+    #define SIM_VECTOR TIMER1_COMPA_vect
+  #elif defined(RSBUS_USES_HW_T3)
+    #define SIM_TCNT TCNT3
+    #define SIM_OCR OCR3A
+    #define SIM_VECTOR TIMER3_COMPA_vect
+  #elif defined(RSBUS_USES_HW_T4)
+    #define SIM_TCNT TCNT4
+    #define SIM_OCR OCR4A
+    #define SIM_VECTOR TIMER4_COMPA_vect
+  #else
+    #define SIM_TCNT TCNT5
+    #define SIM_OCR OCR5A
+    #define SIM_VECTOR TIMER5_COMPA_vect
+  #endif
+  extern "C" void SIM_VECTOR(void);
+  const bool BusInput::detectsLateIsr = true;
+  const bool BusInput::rejectsNoise = false;
+#elif defined(RSBUS_USES_RTC)
+  // RTC: counts pulses. The compare interrupt is raised at the first count after CNT equals CMP,
+  // the overflow interrupt at the count after CNT equals PER. A value written to CNT becomes active
+  // after CMP_DELAY (3) pulses, which are not counted. Thus resetAddressPolled() writes 3 during the
+  // silence, to get CNT in sync with the master again
+  #define SIM_RTC
+  extern "C" void RTC_CNT_vect(void);
+  const bool BusInput::detectsLateIsr = true;
+  const bool BusInput::rejectsNoise = false;
+#endif
+
+
+//******************************************************************************************************
+BusInput::BusInput(uint8_t busNumber) {
+  bus = busNumber;
+  written = false;
+  data = 0;
+}
+
+
+uint32_t BusInput::nibblesSent(void) {
+  #if (RSBUS_BUSES > 1)
+  if (bus == 1) return rsISR1.nibblesSent;
+  #endif
+  #if (RSBUS_BUSES > 2)
+  if (bus == 2) return rsISR2.nibblesSent;
+  #endif
+  return rsISR.nibblesSent;
+}
+
+
+void BusInput::interrupt(void) {
+  #if defined(SIM_PIN_ISR) && defined(RSBUS_SW_PCINT)
+  PINB |= (1 << 2);                    // Rising edge on pin 2: the ISR counts this one
+  PCINT0_vect();
+  PINB &= ~(1 << 2);                   // And the falling edge, which the ISR ignores
+  PCINT0_vect();
+  #elif defined(SIM_PIN_ISR)
+  if (pinIsr) pinIsr();
+  #elif defined(SIM_SW_TCB)
+  #if (RSBUS_BUSES > 1)
+  if (bus == 1) {SIM_XCAT3(TCB, RSBUS_BUS1_TCB, _INT_vect)(); return;}
+  #endif
+  #if (RSBUS_BUSES > 2)
+  if (bus == 2) {SIM_XCAT3(TCB, RSBUS_BUS2_TCB, _INT_vect)(); return;}
+  #endif
+  SIM_XCAT3(TCB, RSBUS_BUS0_TCB, _INT_vect)();
+  #elif defined(SIM_HW_TCB) || defined(SIM_HW_TX)
+  SIM_VECTOR();
+  #elif defined(SIM_HW_TCA)
+  TCA0_CMP0_vect();
+  #elif defined(SIM_RTC)
+  RTC_CNT_vect();
+  #endif
+}
+
+
+#if defined(SIM_SW_TCB)
+static volatile TCB_t *tcbOfBus(uint8_t bus) {
+  static volatile TCB_t * const tcb[] = {&TCB0, &TCB1, &TCB2, &TCB3, &TCB4};
+  #if (RSBUS_BUSES > 1)
+  if (bus == 1) return tcb[RSBUS_BUS1_TCB];
+  #endif
+  #if (RSBUS_BUSES > 2)
+  if (bus == 2) return tcb[RSBUS_BUS2_TCB];
+  #endif
+  return tcb[RSBUS_BUS0_TCB];
+}
+#endif
+
+
+uint8_t BusInput::pulse(bool lateIsr, bool glitch) {
+  uint32_t before = nibblesSent();
+  uint8_t used = 1;
+  #if defined(SIM_SW_TCB)
+  uint16_t period = (simTime - lastEdge) * TICKS_PER_US; // Like CCMP, wraps around during the silence
+  #endif
+  lastEdge = simTime;
+  #if defined(SIM_PIN_ISR)
+  // The ISR runs late, but can't know that
+  interrupt();
+  #elif defined(SIM_SW_TCB)
+  // Frequency measurement mode: CCMP is the time since the previous edge, the counter restarts.
+  // A late ISR sees a CNT value above maxSendDelay. A glitch 3us after the edge is captured after the
+  // ISR read CCMP, but before it reads CNT: CNT restarted, and the capture flag is set again. The
+  // glitch's own interrupt follows
+  volatile TCB_t *tcb = tcbOfBus(bus);
+  tcb->CCMP = period;
+  tcb->CNT = (lateIsr ? 150 : (glitch ? 2 : 10)) * TICKS_PER_US;
+  tcb->INTFLAGS = glitch ? TCB_CAPT_bm : 0;
+  interrupt();
+  if (glitch) {
+    tcb->CCMP = 3 * TICKS_PER_US;
+    tcb->CNT = 6 * TICKS_PER_US;
+    tcb->INTFLAGS = 0;
+    lastEdge = simTime + 3;
+    interrupt();
+  }
+  #elif defined(SIM_HW_TCB)
+  if (SIM_TIMER.CNT == SIM_TIMER.CCMP) {
+    SIM_TIMER.CNT = 0;
+    SIM_TIMER.INTFLAGS = TCB_CAPT_bm;
+    if (lateIsr) {SIM_TIMER.CNT++; used = 2;}
+    interrupt();
+  }
+  else SIM_TIMER.CNT++;
+  #elif defined(SIM_HW_TCA)
+  TCA0.SINGLE.CNT++;
+  if (TCA0.SINGLE.CNT == TCA0.SINGLE.CMP0) {
+    TCA0.SINGLE.INTFLAGS = TCA_SINGLE_CMP0_bm;
+    if (lateIsr) {TCA0.SINGLE.CNT++; used = 2;}
+    interrupt();
+  }
+  #elif defined(SIM_HW_TX)
+  bool match = (SIM_TCNT == SIM_OCR);
+  SIM_TCNT++;
+  if (match) {
+    if (lateIsr) {SIM_TCNT++; used = 2;}
+    interrupt();
+  }
+  #elif defined(SIM_RTC)
+  if (RTC.CNT != cntSeen) writeLag = 3;          // The decoder wrote CNT since the previous pulse
+  if (writeLag) writeLag--;
+  else {
+    bool match = (RTC.CNT == RTC.CMP);
+    bool overflow = (RTC.CNT == RTC.PER);
+    RTC.CNT = overflow ? 0 : RTC.CNT + 1;
+    if (match) {
+      if (lateIsr) {RTC.CNT++; used = 2;}
+      RTC.INTFLAGS = RTC_CMP_bm;
+      interrupt();
+    }
+    if (overflow) {
+      RTC.INTFLAGS = RTC_OVF_bm;
+      interrupt();
+    }
+  }
+  cntSeen = RTC.CNT;
+  #endif
+  written = (nibblesSent() != before);
+  data = (written) ? *txData : 0;
+  return used;
+}
+
+
+void BusInput::spike(void) {
+  // A noise edge. The pulse counting variants count it as a pulse, SW_TCBx may reject it
+  #if defined(SIM_SW_TCB)
+  uint32_t before = nibblesSent();
+  volatile TCB_t *tcb = tcbOfBus(bus);
+  tcb->CCMP = (simTime - lastEdge) * TICKS_PER_US;
+  tcb->CNT = 2 * TICKS_PER_US;
+  tcb->INTFLAGS = 0;
+  lastEdge = simTime;
+  interrupt();
+  written = (nibblesSent() != before);
+  data = (written) ? *txData : 0;
+  #else
+  pulse(false, false);
+  #endif
+}
+
+
+//******************************************************************************************************
+// The silence timer. SW_Tx: a timer overflow, RSBUS_SILENCE_PIT: the RTC's periodic interrupt,
+// RSBUS_SILENCE_TCBx: a TCB in periodic interrupt mode. All call resetAddressPolled() every 2ms
+//******************************************************************************************************
+#if defined(RSBUS_USES_SW_T1)
+  #define SIM_SILENCE_VECTOR TIMER1_OVF_vect
+#elif defined(RSBUS_USES_SW_T3)
+  #define SIM_SILENCE_VECTOR TIMER3_OVF_vect
+#elif defined(RSBUS_USES_SW_T4)
+  #define SIM_SILENCE_VECTOR TIMER4_OVF_vect
+#elif defined(RSBUS_USES_SW_T5)
+  #define SIM_SILENCE_VECTOR TIMER5_OVF_vect
+#elif defined(RSBUS_SILENCE_PIT)
+  #define SIM_SILENCE_VECTOR RTC_PIT_vect
+  #define SIM_SILENCE_PERIOD 1953        // 64 cycles of the 32.768kHz oscillator
+#elif defined(RSBUS_SILENCE_TCB0)
+  #define SIM_SILENCE_VECTOR TCB0_INT_vect
+#elif defined(RSBUS_SILENCE_TCB1)
+  #define SIM_SILENCE_VECTOR TCB1_INT_vect
+#elif defined(RSBUS_SILENCE_TCB2)
+  #define SIM_SILENCE_VECTOR TCB2_INT_vect
+#elif defined(RSBUS_SILENCE_TCB3)
+  #define SIM_SILENCE_VECTOR TCB3_INT_vect
+#elif defined(RSBUS_SILENCE_TCB4)
+  #define SIM_SILENCE_VECTOR TCB4_INT_vect
+#endif
+#if !defined(SIM_SILENCE_PERIOD)
+  #define SIM_SILENCE_PERIOD 2000
+#endif
+
+#if defined(SIM_SILENCE_VECTOR)
+extern "C" void SIM_SILENCE_VECTOR(void);
+#endif
+
+void simTimers(void) {
+  #if defined(SIM_SILENCE_VECTOR)
+  static unsigned long tNext = SIM_SILENCE_PERIOD;
+  if ((long)(simTime - tNext) >= 0) {
+    tNext += SIM_SILENCE_PERIOD;
+    SIM_SILENCE_VECTOR();
+  }
+  #endif
+}
@@ -0,0 +1,535 @@
+//******************************************************************************************************
+//
+// file:      sim_main.cpp
+// author:    Aiko Pras
+// history:   2026-10-14 V1.0 ag Initial version
+//
+// purpose:   RS-bus simulator: the scenarios, for the variant the library is compiled for.
+//            Each scenario starts from power-up, in its own process, and prints a single report line
+//            with the throughput, latency or recovery time it measured. Checks that fail are printed
+//            as well, and make the exit code non-zero. Thus "make" in extras/sim is a regression test
+//            of all variants (see README.md).
+//
+//            Usage: sim [scenario]          without scenario all scenarios run
+//
+//******************************************************************************************************
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "sim.h"
+
+#if !defined(SIM_VARIANT)
+#define SIM_VARIANT "default"         // The Makefile gives the name of the variant
+#endif
+
+#if defined(RSBUS_FIXED_ADDRESS)
+const uint8_t FIRST_ADDRESS = RSBUS_FIXED_ADDRESS;
+#else
+const uint8_t FIRST_ADDRESS = 10;      // Connection i uses FIRST_ADDRESS + i
+#endif
+#if defined(RSBUS_USES_SW_4MS)
+const bool DETECTS_PARITY = false;     // The 4ms check can't tell a parity error from the normal silence
+#else
+const bool DETECTS_PARITY = true;
+#endif
+const uint8_t ADDRESS_STEP = 4;       // RTC: slots in the same cycle must be CMP_DELAY + 1 addresses apart
+const uint8_t MAX_CONNECTIONS = 8;
+const unsigned long T_CYCLE = (unsigned long) PULSES * T_PULSE + T_SILENCE; // Without bytes
+
+
+//******************************************************************************************************
+// The decoder under test: the loop() of its sketch
+//******************************************************************************************************
+struct Decoder {
+  RSbusConnection *connection[MAX_CONNECTIONS];
+  uint8_t bus[MAX_CONNECTIONS] = {};     // The RS-bus of each connection
+  uint8_t count = 0;
+  uint8_t value[MAX_CONNECTIONS] = {};   // The 8 feedback bits of each connection
+  uint16_t pending[MAX_CONNECTIONS] = {}; // New values loop() should still hand over
+  bool answers = true;                   // loop() answers feedbackRequested with send8bits()
+  uint32_t answered = 0;                 // The number of times it did
+  unsigned long handOverAt = 0;          // loop() calls send8bits() for connection 0 at this time
+  unsigned long handedOver = 0;          // The time it did
+};
+
+static Decoder decoder;
+
+static void decoderLoop(void) {
+  for (uint8_t i = 0; i < decoder.count; i++) {
+    RSbusConnection &connection = *decoder.connection[i];
+    if (decoder.answers && connection.feedbackRequested) {
+      connection.send8bits(decoder.value[i]);
+      decoder.answered++;
+    }
+    // Both nibbles change with every new value. The queue is kept short, since the connections share
+    // the FIFO pool: a connection that takes the whole pool would leave the other slots idle
+    while (decoder.pending[i] && (connection.queueDepth() < 4) &&
+      connection.trySend8bits(decoder.value[i] + 0x11)) {
+      decoder.value[i] += 0x11;
+      decoder.pending[i]--;
+    }
+  }
+  if (decoder.handOverAt && (simTime >= decoder.handOverAt)) {
+    decoder.value[0] += 0x11;
+    decoder.connection[0]->send8bits(decoder.value[0]);
+    decoder.handedOver = simTime;
+    decoder.handOverAt = 0;
+  }
+  for (uint8_t bus = 0; bus < SIM_BUSES; bus++) simHardware(bus).checkPolling();
+  for (uint8_t i = 0; i < decoder.count; i++) decoder.connection[i]->checkConnection();
+}
+
+static CommandStation station(decoderLoop);
+
+
+//******************************************************************************************************
+// Helpers for the scenarios
+//******************************************************************************************************
+static const char *scenarioName = "";
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+  if (ok) return;
+  printf("%-14s %-14s FAIL: %s\n", SIM_VARIANT, scenarioName, what);
+  failures++;
+}
+
+
+static double ms(unsigned long us) {return us / 1000.0;}
+
+
+static uint8_t slotsFor(uint8_t wanted) {
+  // The variant may support less transmit slots (RSBUS_FIXED_ADDRESS: 1)
+  return (wanted < RSBUS_MAX_SLOTS) ? wanted : RSBUS_MAX_SLOTS;
+}
+
+
+static RSbusConnection &connect(uint8_t address, uint8_t value, uint8_t bus = 0) {
+  RSbusConnection *connection = new RSbusConnection(bus);
+  connection->address = address;
+  decoder.connection[decoder.count] = connection;
+  decoder.bus[decoder.count] = bus;
+  decoder.value[decoder.count] = value;
+  decoder.count++;
+  return *connection;
+}
+
+
+static void attachAll(void) {
+  // Bus 0 uses USART 0, the other buses USART 2 and 3. The pin number has no meaning here
+  for (uint8_t bus = 0; bus < SIM_BUSES; bus++) station.attach(bus, (bus == 0) ? 0 : bus + 1, 2 + bus);
+}
+
+
+static uint8_t addressOf(uint8_t i) {return decoder.connection[i]->address;}
+static uint8_t busOf(uint8_t i) {return decoder.bus[i];}
+
+
+static bool allKnown(void) {
+  for (uint8_t i = 0; i < decoder.count; i++)
+    if (!station.knows(addressOf(i), decoder.value[i], busOf(i))) return false;
+  return true;
+}
+
+
+static uint8_t cyclesUntilKnown(uint8_t limit) {
+  // Returns the number of cycles after which the master knows the values of all connections
+  for (uint8_t n = 1; n <= limit; n++) {
+    station.cycles(1);
+    if (allKnown()) return n;
+  }
+  return 0;
+}
+
+
+static uint32_t misplaced(void) {
+  // Bytes the master received from addresses that don't belong to a connection
+  uint32_t count = 0;
+  for (uint8_t bus = 0; bus < SIM_BUSES; bus++)
+    for (uint8_t address = 1; address <= 128; address++) {
+      bool used = false;
+      for (uint8_t i = 0; i < decoder.count; i++)
+        if ((addressOf(i) == address) && (busOf(i) == bus)) used = true;
+      if (!used) count += station.bytes[bus][address];
+    }
+  return count;
+}
+
+
+static RSbusTelemetry telemetry(uint8_t bus = 0) {
+  RSbusTelemetry copy;
+  simHardware(bus).getTelemetry(copy);
+  return copy;
+}
+
+
+static void report(const char *format, ...) __attribute__((format(printf, 1, 2)));
+static void report(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  printf("%-14s %-14s ", SIM_VARIANT, scenarioName);
+  vprintf(format, args);
+  printf("\n");
+  va_end(args);
+}
+
+
+static bool startUp(void) {
+  // Power-up, followed by the cycles that synchronise all connections with the master
+  attachAll();
+  bool ok = (cyclesUntilKnown(10) != 0);
+  check(ok, "connections did not synchronise");
+  for (uint8_t bus = 0; bus < SIM_BUSES; bus++) simHardware(bus).clearTelemetry();
+  return ok;
+}
+
+
+static unsigned long deliver(uint8_t address, uint8_t value, uint8_t limit, unsigned long since) {
+  // Runs cycles until the master knows value. Returns the time of its last byte, relative to since
+  for (uint8_t n = 0; n < limit; n++) {
+    station.cycles(1);
+    if (station.knows(address, value)) return station.lastByte[0][address] - since;
+  }
+  return 0;
+}
+
+
+//******************************************************************************************************
+// The scenarios
+//******************************************************************************************************
+static void startup(void) {
+  // The time until the decoder sees a valid signal, and until the master knows all connections
+  uint8_t connections = slotsFor(3);
+  for (uint8_t i = 0; i < connections; i++) connect(FIRST_ADDRESS + ADDRESS_STEP * i, 0x5A + i);
+  for (uint8_t bus = 1; bus < SIM_BUSES; bus++) connect(FIRST_ADDRESS + 10 * bus, 0x33 * bus, bus);
+  attachAll();
+  unsigned long signal = 0;
+  uint8_t n;
+  for (n = 1; n <= 10; n++) {
+    station.cycles(1);
+    if (!signal && rsbusHardware.rsSignalIsOK) signal = simTime;
+    if (allKnown()) break;
+  }
+  report("signal=%.1fms connected=%.1fms cycles=%u", ms(signal), ms(simTime), n);
+  check(n <= 4, "more than 4 cycles needed to connect");
+  check(station.badBytes == 0, "bytes with a bad parity");
+  check(misplaced() == 0, "bytes from a wrong address");
+}
+
+
+static void throughput(void) {
+  // Every connection has a new value waiting all the time. Each slot should send once per cycle
+  uint8_t connections = slotsFor(3);
+  for (uint8_t i = 0; i < connections; i++) connect(FIRST_ADDRESS + ADDRESS_STEP * i, 0x00);
+  for (uint8_t bus = 1; bus < SIM_BUSES; bus++) connect(FIRST_ADDRESS + 10 * bus, 0x00, bus);
+  if (!startUp()) return;
+  const uint16_t CYCLES = 100;
+  uint32_t before = 0;
+  for (uint8_t i = 0; i < decoder.count; i++) {
+    before += station.bytes[busOf(i)][addressOf(i)];
+    decoder.pending[i] = 1000;
+  }
+  unsigned long start = simTime;
+  station.cycles(CYCLES);
+  uint32_t bytes = 0;
+  for (uint8_t i = 0; i < decoder.count; i++) {
+    bytes += station.bytes[busOf(i)][addressOf(i)];
+    decoder.pending[i] = 0;
+  }
+  bytes -= before;
+  double perCycle = (double) bytes / CYCLES;
+  uint32_t sent = 0, overflows = 0;
+  for (uint8_t bus = 0; bus < SIM_BUSES; bus++) {
+    sent += telemetry(bus).nibblesSent;
+    overflows += telemetry(bus).fifoOverflows;
+  }
+  report("nibbles/cycle=%.2f nibbles/s=%.0f bytes=%u cycles=%u", perCycle,
+    bytes / (ms(simTime - start) / 1000.0), bytes, CYCLES);
+  check(perCycle >= 0.98 * decoder.count, "less than one nibble per connection per cycle");
+  check(sent == bytes, "the master didn't receive all nibbles the ISR send");
+  check(overflows == 0, "FIFO overflows, although trySend8bits() was used");
+  check(cyclesUntilKnown(8) != 0, "the last values were not delivered");
+  check((station.badBytes == 0) && (misplaced() == 0), "bad or misplaced bytes");
+}
+
+
+static void latency(void) {
+  // The time from send8bits() until the master knows the new value, handed over at a random moment
+  connect(FIRST_ADDRESS, 0x00);
+  if (!startUp()) return;
+  const uint8_t TRIALS = 40;
+  unsigned long total = 0, worst = 0;
+  uint8_t delivered = 0;
+  for (uint8_t k = 0; k < TRIALS; k++) {
+    // loop() hands the value over during the next cycles, each time at another moment in the cycle
+    decoder.handOverAt = simTime + 1 + (k * 7919UL) % T_CYCLE;
+    uint8_t value = decoder.value[0] + 0x11;
+    unsigned long delay = 0;
+    for (uint8_t n = 0; (n < 8) && !delay; n++) {
+      station.cycles(1);
+      if (station.knows(FIRST_ADDRESS, value)) delay = station.lastByte[0][FIRST_ADDRESS] - decoder.handedOver;
+    }
+    if (delay) {
+      delivered++;
+      total += delay;
+      if (delay > worst) worst = delay;
+    }
+  }
+  report("avg=%.1fms max=%.1fms trials=%u delivered=%u", ms(total / (delivered ? delivered : 1)),
+    ms(worst), TRIALS, delivered);
+  check(delivered == TRIALS, "not all values were delivered");
+  // Each cycle a slot sends one nibble, so the worst case is the cycle during which loop() handed
+  // the value over, plus a cycle per nibble
+  check(worst < 3 * (T_CYCLE + T_BYTE), "latency of 3 cycles or more");
+}
+
+
+static void parity(uint8_t strategy, uint8_t fec) {
+  // The master receives the first nibble of a new value with a parity error
+  RSbusConnection &connection = connect(FIRST_ADDRESS, 0x00);
+  connection.forwardErrorCorrection = fec;
+  rsbusHardware.parityErrorHandling = strategy;
+  if (!startUp()) return;
+  uint32_t answered = decoder.answered;
+  decoder.value[0] = 0xC3;
+  connection.send8bits(decoder.value[0]);
+  // The nibble is send in the first or second cycle, depending on when loop() handed it over
+  Cycle errored;
+  errored.parityError = true;
+  for (uint8_t n = 0; (n < 3) && (station.parityErrors == 0); n++) station.cycle(errored);
+  unsigned long recovery = deliver(FIRST_ADDRESS, decoder.value[0], 12, simTime);
+  RSbusTelemetry t = telemetry();
+  report("recovery=%.1fms parityErrors=%u retransmissions=%u resyncs=%u", ms(recovery),
+    t.parityErrors, t.retransmissions, t.resyncs);
+  check(station.parityErrors == 1, "no nibble was send in the cycle with the parity error");
+  check(recovery != 0, "the value was not delivered after the parity error");
+  // Each nibble is send 1 + fec times, thus the value needs 2 * (1 + fec) cycles after the error
+  check(recovery < (2 * (1 + fec) + 1) * (T_CYCLE + T_BYTE), "recovery took too many cycles");
+  if (!DETECTS_PARITY) return;
+  check(t.parityErrors == 1, "the parity error was not detected");
+  if (strategy == 3) {
+    check(t.resyncs == 0, "selective retransmission made the connection resynchronise");
+    check(decoder.answered == answered, "selective retransmission needed loop()");
+  }
+  else check(decoder.answered > answered, "loop() was not asked for the feedback again");
+}
+
+
+static void pulseCount(void) {
+  // A pulse train with a missing pulse, and later one with an extra pulse
+  connect(FIRST_ADDRESS, 0x00);
+  if (!startUp()) return;
+  unsigned long worst = 0;
+  bool delivered = true;
+  for (uint8_t pulses = PULSES - 1; pulses <= PULSES + 1; pulses += 2) {
+    decoder.value[0] += 0x11;
+    decoder.connection[0]->send8bits(decoder.value[0]);
+    Cycle errored;
+    errored.pulses = pulses;
+    station.cycle(errored);
+    unsigned long recovery = deliver(FIRST_ADDRESS, decoder.value[0], 10, simTime);
+    if (!recovery) delivered = false;
+    if (recovery > worst) worst = recovery;
+  }
+  RSbusTelemetry t = telemetry();
+  report("recovery=%.1fms pulseCountErrors=%u resyncs=%u", ms(worst), t.pulseCountErrors, t.resyncs);
+  check(t.pulseCountErrors == 2, "not both pulse count errors were detected");
+  check(delivered, "a value was not delivered after a pulse count error");
+  check(worst < 4 * T_CYCLE, "recovery took 4 cycles or more");
+}
+
+
+static void noise(void) {
+  // A noise edge, just after the pulse that polls address 5
+  connect(FIRST_ADDRESS, 0x00);
+  if (!startUp()) return;
+  decoder.value[0] = 0x96;
+  decoder.connection[0]->send8bits(decoder.value[0]);
+  Cycle noisy;
+  noisy.spikeAddress = 5;
+  station.cycle(noisy);
+  unsigned long recovery = deliver(FIRST_ADDRESS, decoder.value[0], 10, simTime);
+  RSbusTelemetry t = telemetry();
+  report("recovery=%.1fms rejected=%u pulseCountErrors=%u misplaced=%u", ms(recovery),
+    t.rejectedPulses, t.pulseCountErrors, misplaced());
+  check(recovery != 0, "the value was not delivered after the noise");
+  if (BusInput::rejectsNoise) {
+    check(t.rejectedPulses == 1, "the noise edge was not rejected");
+    check(t.pulseCountErrors == 0, "the noise edge caused a pulse count error");
+    check(misplaced() == 0, "a byte was send from a wrong address");
+  }
+  else check(t.pulseCountErrors == 1, "the extra pulse was not detected");
+}
+
+
+static void lateIsr(void) {
+  // The ISR of the first connection starts too late: the nibble must wait for the next cycle, and
+  // neither the slot of the next address nor the next connection (if any) may be disturbed
+  uint8_t connections = slotsFor(2);
+  for (uint8_t i = 0; i < connections; i++) connect(FIRST_ADDRESS + i, 0x00);
+  if (!startUp()) return;
+  if (!BusInput::detectsLateIsr) {
+    report("n/a (the ISR can't detect it)");
+    return;
+  }
+  for (uint8_t i = 0; i < connections; i++) {
+    decoder.value[i] = 0x69 + i;
+    decoder.connection[i]->send8bits(decoder.value[i]);
+  }
+  // The nibble is send in the first or second cycle, depending on when loop() handed it over
+  Cycle late;
+  late.lateAddress = FIRST_ADDRESS;
+  for (uint8_t n = 0; (n < 3) && (telemetry().lateSkips == 0); n++) station.cycle(late);
+  unsigned long start = simTime;
+  uint8_t n = cyclesUntilKnown(8);
+  RSbusTelemetry t = telemetry();
+  report("lateSkips=%u delivered=%.1fms misplaced=%u", t.lateSkips, ms(simTime - start), misplaced());
+  check(t.lateSkips == 1, "the late ISR was not detected");
+  check(n != 0, "the values were not delivered");
+  check(misplaced() == 0, "a byte was send from a wrong address");
+  check(station.badBytes == 0, "bytes with a bad parity");
+}
+
+
+static void glitch(void) {
+  // SW_TCBx: a noise edge right after our pulse restarts the TCB before the ISR reads CNT. The ISR
+  // can't tell how long ago its pulse started, and must keep the nibble for the next cycle
+  connect(FIRST_ADDRESS, 0x00);
+  if (!startUp()) return;
+  if (!BusInput::rejectsNoise) {
+    report("n/a (noise is counted as a pulse, see noise)");
+    return;
+  }
+  decoder.value[0] = 0x5A;
+  decoder.connection[0]->send8bits(decoder.value[0]);
+  Cycle noisy;
+  noisy.glitchAddress = FIRST_ADDRESS;
+  for (uint8_t n = 0; (n < 3) && (telemetry().lateSkips == 0); n++) station.cycle(noisy);
+  unsigned long start = simTime;
+  uint8_t n = cyclesUntilKnown(8);
+  RSbusTelemetry t = telemetry();
+  report("lateSkips=%u rejected=%u delivered=%.1fms misplaced=%u", t.lateSkips, t.rejectedPulses,
+    ms(simTime - start), misplaced());
+  check(t.lateSkips == 1, "the nibble was send, although the time since its pulse was unknown");
+  check(t.rejectedPulses >= 1, "the noise edge was not rejected");
+  check(t.pulseCountErrors == 0, "the noise edge caused a pulse count error");
+  check(n != 0, "the value was not delivered");
+  check(misplaced() == 0, "a byte was send from a wrong address");
+}
+
+
+static void signalLoss(bool cached) {
+  // 20ms of silence. Afterwards all connections synchronise again. The cached variant uses
+  // cachedResync, with a value that was only handed over by send4bits(): loop() never answers
+  RSbusConnection &connection = connect(FIRST_ADDRESS, 0xA5);
+  if (cached) {
+    connection.cachedResync = true;
+    connection.send4bits(LowBits, 0x5);
+    connection.send4bits(HighBits, 0xA);
+    decoder.answers = false;
+  }
+  if (!startUp()) return;
+  uint32_t before = station.bytes[0][FIRST_ADDRESS];
+  Cycle lost;
+  lost.silence = T_LOSS;
+  station.cycle(lost);
+  unsigned long start = simTime;
+  uint8_t n;
+  for (n = 1; n <= 10; n++) {
+    station.cycles(1);
+    if (station.bytes[0][FIRST_ADDRESS] >= before + 2) break;
+  }
+  RSbusTelemetry t = telemetry();
+  report("recovery=%.1fms cycles=%u signalLosses=%u resyncs=%u answered=%u",
+    ms(station.lastByte[0][FIRST_ADDRESS] - start), n, t.signalLosses, t.resyncs, decoder.answered);
+  check(t.signalLosses == 1, "the signal loss was not detected");
+  check(t.resyncs == 1, "the connection did not resynchronise");
+  check(n <= 4, "more than 4 cycles needed to send the feedback again");
+  check(station.knows(FIRST_ADDRESS, 0xA5), "the master doesn't know the right value");
+  if (cached) check(decoder.answered == 0, "loop() was needed to resynchronise");
+}
+
+
+static void buses(void) {
+  // Bus 1 loses its signal for 5 cycles. Bus 0 (and bus 2) must not notice
+  if (SIM_BUSES == 1) {
+    report("n/a (a single bus)");
+    return;
+  }
+  for (uint8_t bus = 0; bus < SIM_BUSES; bus++) connect(FIRST_ADDRESS + 10 * bus, 0x00, bus);
+  if (!startUp()) return;
+  Cycle bus1Lost;
+  bus1Lost.silentBuses = 0b010;
+  decoder.value[0] = 0x3C;
+  decoder.connection[0]->send8bits(decoder.value[0]);
+  for (uint8_t n = 0; n < 5; n++) station.cycle(bus1Lost);
+  bool bus0Delivered = station.knows(FIRST_ADDRESS, decoder.value[0]);
+  uint8_t n = cyclesUntilKnown(8);
+  RSbusTelemetry t0 = telemetry(0), t1 = telemetry(1);
+  report("bus0Losses=%u bus1Losses=%u recovery=%u cycles", t0.signalLosses, t1.signalLosses, n);
+  check(t0.signalLosses == 0, "bus 0 did notice the signal loss of bus 1");
+  check(bus0Delivered, "bus 0 did not deliver while bus 1 was silent");
+  check(t1.signalLosses == 1, "bus 1 did not detect its signal loss");
+  check(n != 0, "bus 1 did not synchronise again");
+}
+
+
+static void parityDefault(void) {parity(1, 0);}
+static void paritySelective(void) {parity(3, 0);}
+static void parityFec(void) {parity(3, 2);}
+static void signalLossNormal(void) {signalLoss(false);}
+static void signalLossCached(void) {signalLoss(true);}
+
+struct Scenario {
+  const char *name;
+  void (*run)(void);
+};
+
+static const Scenario scenarios[] = {
+  {"startup", startup},
+  {"throughput", throughput},
+  {"latency", latency},
+  {"parity", parityDefault},
+  {"parity-select", paritySelective},
+  {"parity-fec2", parityFec},
+  {"pulse-count", pulseCount},
+  {"noise", noise},
+  {"late-isr", lateIsr},
+  {"glitch", glitch},
+  {"signal-loss", signalLossNormal},
+  {"cached-resync", signalLossCached},
+  {"buses", buses},
+};
+
+
+//******************************************************************************************************
+int main(int argc, char *argv[]) {
+  // Every scenario runs in a child process, thus starts with the library in its power-up state
+  int failed = 0;
+  int run = 0;
+  for (const Scenario &scenario : scenarios) {
+    if ((argc > 1) && strcmp(argv[1], scenario.name)) continue;
+    run++;
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+      scenarioName = scenario.name;
+      scenario.run();
+      fflush(stdout);
+      _exit(failures ? 1 : 0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (WIFSIGNALED(status)) printf("%-14s %-14s FAIL: crashed (signal %d)\n", SIM_VARIANT, scenario.name,
+      WTERMSIG(status));
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) failed++;
+  }
+  if (run == 0) {
+    printf("Unknown scenario: %s\n", argv[1]);
+    return 2;
+  }
+  if (failed) printf("%-14s %d of %d scenarios FAILED\n", SIM_VARIANT, failed, run);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+//******************************************************************************************************
+//
+// file:      sim_master.cpp
+// author:    Aiko Pras
+// history:   2026-10-14 V1.0 ag Initial version
+//
+// purpose:   RS-bus simulator: the command station (see sim.h).
+//            Generates the pulse trains, with the errors requested per cycle, and receives the bytes
+//            the decoder writes to its USART. While a decoder sends, the master waits (T_BYTE) before
+//            it continues with the next pulse. Each byte is matched to the address being polled, and
+//            its parity and TT bits are checked, using the message layout of RSbusConnection (see
+//            RSbus.cpp). A bad byte makes the master signal a parity error, by a longer silence.
+//
+//******************************************************************************************************
+#include "sim.h"
+
+#if (RSBUS_BUSES > 1)
+extern RSbusHardware rsbusHardware1;
+#endif
+#if (RSBUS_BUSES > 2)
+extern RSbusHardware rsbusHardware2;
+#endif
+
+
+RSbusHardware &simHardware(uint8_t bus) {
+  #if (RSBUS_BUSES > 1)
+  if (bus == 1) return rsbusHardware1;
+  #endif
+  #if (RSBUS_BUSES > 2)
+  if (bus == 2) return rsbusHardware2;
+  #endif
+  (void) bus;
+  return rsbusHardware;
+}
+
+
+static volatile uint8_t *usartData(uint8_t usartNumber) {
+  // The data register that USART::init() selects for this usartNumber
+  #if defined(MOCK_XMEGA)
+  static volatile uint8_t * const data[] = {&USART0.TXDATAL, &USART1.TXDATAL, &USART2.TXDATAL,
+    &USART3.TXDATAL, &USART4.TXDATAL, &USART5.TXDATAL};
+  return (usartNumber < 6) ? data[usartNumber] : 0;
+  #else
+  static volatile uint8_t * const data[] = {&UDR0, &UDR1, &UDR2, &UDR3};
+  return (usartNumber < 4) ? data[usartNumber] : 0;
+  #endif
+}
+
+
+//******************************************************************************************************
+CommandStation::CommandStation(MainLoop loop) {
+  decoderLoop = loop;
+  for (uint8_t bus = 0; bus < SIM_BUSES; bus++) input[bus] = BusInput(bus);
+}
+
+
+void CommandStation::attach(uint8_t bus, uint8_t usartNumber, uint8_t rxPin) {
+  simHardware(bus).attach(usartNumber, rxPin);
+  input[bus].txData = usartData(usartNumber);
+}
+
+
+void CommandStation::wait(unsigned long time) {
+  unsigned long end = simTime + time;
+  while (simTime < end) {
+    unsigned long step = end - simTime;
+    simTime += (step < LOOP_TIME) ? step : LOOP_TIME;
+    simTimers();
+    decoderLoop();
+  }
+}
+
+
+void CommandStation::cycle(const Cycle &cycle) {
+  uint8_t pulse = 1;                   // Pulse 1 polls address 0, pulse A+1 polls address A
+  while (pulse <= cycle.pulses) {
+    uint8_t address = pulse - 1;
+    uint8_t used = 1;
+    bool sending = false;
+    for (uint8_t bus = 0; bus < SIM_BUSES; bus++) {
+      if (cycle.silentBuses & (1 << bus)) continue;
+      bool late = (bus == 0) && cycle.lateAddress && (address == cycle.lateAddress);
+      bool glitch = (bus == 0) && cycle.glitchAddress && (address == cycle.glitchAddress);
+      uint8_t pulses = input[bus].pulse(late, glitch);
+      if (bus == 0) used = pulses;
+      if (input[bus].written) {
+        sending = true;
+        if (cycle.parityError) parityError = true;
+        else receive(bus, address, input[bus].data);
+      }
+    }
+    if (cycle.spikeAddress && (address == cycle.spikeAddress)) {
+      wait(20);
+      for (uint8_t bus = 0; bus < SIM_BUSES; bus++) {
+        if (cycle.silentBuses & (1 << bus)) continue;
+        input[bus].spike();
+        if (input[bus].written) {sending = true; receive(bus, address, input[bus].data);}
+      }
+      wait(T_PULSE - 20);
+    }
+    else wait(T_PULSE);
+    if (used > 1) wait((used - 1) * T_PULSE);
+    if (sending) wait(T_BYTE - T_PULSE);
+    pulse += used;
+  }
+  // A parity error makes the master wait longer. Normally the decoders then resend their data
+  if (parityError) parityErrors++;
+  wait((parityError && (cycle.silence < T_PARITY)) ? T_PARITY : cycle.silence);
+  parityError = false;
+  cycleCount++;
+}
+
+
+void CommandStation::cycles(uint16_t number) {
+  Cycle normal;
+  for (uint16_t i = 0; i < number; i++) cycle(normal);
+}
+
+
+bool CommandStation::knows(uint8_t address, uint8_t value, uint8_t bus) {
+  return (nibblesSeen[bus][address] == 0x03) && (feedback[bus][address] == value);
+}
+
+
+void CommandStation::receive(uint8_t bus, uint8_t address, uint8_t data) {
+  // Bit layout of a RS-bus message (see RSbusConnection in RSbus.cpp): bit 7..4: data bits 0..3,
+  // bit 3: high (1) or low (0) order nibble, bit 2..1: the TT bits (10 or 01), bit 0: odd parity
+  if ((address < 1) || (address > 128)) {strayBytes++; return;}
+  uint8_t tt = (data >> 1) & 0b11;
+  if ((__builtin_parity(data) == 0) || (tt == 0b00) || (tt == 0b11)) {
+    badBytes++;
+    parityError = true;
+    return;
+  }
+  uint8_t value = ((data >> 7) & 0b0001) | ((data >> 5) & 0b0010) | ((data >> 3) & 0b0100) |
+    ((data >> 1) & 0b1000);
+  if (data & 0b00001000) {
+    feedback[bus][address] = (feedback[bus][address] & 0x0F) | (value << 4);
+    nibblesSeen[bus][address] |= 0x02;
+  }
+  else {
+    feedback[bus][address] = (feedback[bus][address] & 0xF0) | value;
+    nibblesSeen[bus][address] |= 0x01;
+  }
+  bytes[bus][address]++;
+  lastByte[bus][address] = simTime;
+}
@@ -11,6 +11,15 @@
 //            2021-07-26 ap v0.2 Default type is now 'Feedback decoder'
 //            2021-09-30 ap v1.0 Different types of hardware are supported
 //            2021-11-29 ap v2.1 Forward Error Correction added (irrespective of transmission errors)
+//            2026-10-14 ag v2.5 Each connection has its own transmit slot
+//                               Coalescing mode added: instead of a queue, only the latest value is kept
+//                               send8bits() only queues the nibble(s) that differ from the previous value
+//                               Nibbles are encoded using a precomputed (constexpr) table in flash
+//                               Up to RSBUS_SLOT_QUEUE nibbles per connection can wait for the ISR
+//                               Optional execution time statistics
+//                               Up to three RS-bus interfaces, each with its own ISR
+//                               Optional event callbacks, and connections serviced by checkPolling()
+//                               RSbusBank: a range of addresses served by a single object
 //
 //
 //
@@ -39,7 +48,8 @@
 //
 //******************************************************************************************************
 #include <Arduino.h>
-#include <util/parity.h>               // Needed to calculate the parity bit
+#include <avr/pgmspace.h>              // The encoding table is stored in flash
+#include <avr/eeprom.h>                // For loadState() and saveState()
 #include "RSbus.h"
 #include "sup_isr.h"
 #include "sup_fifo.h"
@@ -48,14 +58,212 @@
 //******************************************************************************************************
 // The following object must be visible for the main sketch. This object is declared here,
 // thus the main sketch doesn't need to bother about declaring this necessary object itself.
-// In addition, since this object is defined here, there can only be a single instantiation
-// of the RSbusHardware class, and thus a single RSbusHardware interface per decoder.
+// In addition, since this object is defined here, there is a single instantiation of the
+// RSbusHardware class per RS-bus interface. Decoders normally have one interface; with the SW_TCBx
+// variant up to three interfaces can be configured (see below).
 RSbusHardware rsbusHardware;    // Interface to the main sketch for accessory commands
 
 // The following object should NOT be used by the main sketch, but is instead used by this
 // c++ file as interface to the various support files.
 volatile RSbusIsr rsISR;        // Interface to sup_isr*
 
+// Additional RS-bus interfaces (see RSBUS_BUS1_TCB in RSbusVariants.h). Each has its own objects.
+#if (RSBUS_BUSES > 1)
+RSbusHardware rsbusHardware1(1);
+volatile RSbusIsr rsISR1;
+#endif
+#if (RSBUS_BUSES > 2)
+RSbusHardware rsbusHardware2(2);
+volatile RSbusIsr rsISR2;
+#endif
+
+// Used by the RSbusConnection constructor, to bind a connection to its bus. Since the constructors of
+// global objects in other files may run before the objects above are constructed, only their
+// addresses may be used there.
+static RSbusHardware * const rsHardwareOfBus[RSBUS_BUSES] = {
+  &rsbusHardware,
+  #if (RSBUS_BUSES > 1)
+  &rsbusHardware1,
+  #endif
+  #if (RSBUS_BUSES > 2)
+  &rsbusHardware2,
+  #endif
+};
+
+static volatile RSbusIsr * const rsIsrOfBus[RSBUS_BUSES] = {
+  &rsISR,
+  #if (RSBUS_BUSES > 1)
+  &rsISR1,
+  #endif
+  #if (RSBUS_BUSES > 2)
+  &rsISR2,
+  #endif
+};
+
+
+//******************************************************************************************************
+// Telemetry. See sup_stats.h
+void RSbusHardware::getTelemetry(RSbusTelemetry &copy) {
+  noInterrupts();                              // The ISR may update the counters
+  copy = telemetry;
+  copy.nibblesSent = isr->nibblesSent;
+  copy.rejectedPulses = isr->pulsesRejected;
+  copy.lateSkips = isr->lateSkips;
+  interrupts();
+}
+
+
+void RSbusHardware::clearTelemetry(void) {
+  noInterrupts();
+  memset(&telemetry, 0, sizeof(telemetry));
+  telemetry.periodMin = 0xFFFFFFFF;
+  isr->nibblesSent = 0;
+  isr->pulsesRejected = 0;
+  isr->lateSkips = 0;
+  nibblesReported = 0;                         // For onNibbleSent
+  interrupts();
+}
+
+
+//******************************************************************************************************
+// Event callbacks. checkEvents() is called by checkPolling(), thus always from the main loop and never
+// from an ISR. The callbacks may therefore take their time, use Serial or call send8bits(). To keep the
+// load of checkPolling() low, the events are checked once every 2ms, and not at all if no callback is set
+// and serviceConnections is false.
+// With serviceConnections the connections of this bus are serviced from here as well. Since the slot
+// queues hold a few nibbles and a polling cycle takes at least 26ms, checking the connections every 2ms
+// is sufficient. The main loop then only needs to call checkPolling(). In combination with
+// onFeedbackRequested it may even sleep (idle mode) between the calls: the timer behind micros() wakes
+// the processor at least every few milliseconds.
+void RSbusHardware::checkEvents(void) {
+  if (!serviceConnections && !onSignalOk && !onSignalLost && !onNibbleSent) return;
+  unsigned long now = micros();
+  if ((now - tLastEvents) < 2000) return;
+  tLastEvents = now;
+  if (rsSignalIsOK != signalReported) {        // The signal became OK, or was lost / had errors
+    signalReported = rsSignalIsOK;
+    if (rsSignalIsOK) {
+      if (onSignalOk) onSignalOk();
+    }
+    else if (onSignalLost) onSignalLost();
+  }
+  if (onNibbleSent) {
+    noInterrupts();                            // The ISR may update the counter
+    uint32_t sent = isr->nibblesSent;
+    interrupts();
+    if (sent != nibblesReported) {
+      nibblesReported = sent;
+      onNibbleSent();
+    }
+  }
+  if (serviceConnections) {
+    // A slot either belongs to a connection, or to a bank. Only the first slot of a bank is registered
+    for (uint8_t i = 0; i < RSbusConnection::slotsInUse[bus]; i++) {
+      RSbusConnection *connection = RSbusConnection::connectionOfSlot[bus][i];
+      if (connection) connection->checkConnection();
+        else if (RSbusBank::bankOfSlot[bus][i]) RSbusBank::bankOfSlot[bus][i]->check();
+    }
+  }
+}
+
+
+void RSbusHardware::cycleStarted(bool valid) {
+  // Called by resetAddressPolled() / checkPolling() once a period of silence is detected, thus at
+  // the start of a new polling cycle. valid: the previous cycle had 130 pulses
+  unsigned long now = micros();
+  if (valid) {
+    rsCount(telemetry.cycles);
+    if (cycleValid) {                          // We have two consecutive valid cycles
+      uint32_t period = now - tCycleStart;
+      if (period < telemetry.periodMin) telemetry.periodMin = period;
+      if (period > telemetry.periodMax) telemetry.periodMax = period;
+      // Exponential moving average, with a weight of 1/8 for the new period
+      if (telemetry.periodAverage == 0) telemetry.periodAverage = period;
+        else telemetry.periodAverage = telemetry.periodAverage - (telemetry.periodAverage >> 3) + (period >> 3);
+    }
+  }
+  cycleValid = valid;
+  tCycleStart = now;
+  // Adaptive forward error correction: a single error raises errorScore for 256 valid cycles (roughly
+  // 5 seconds). More errors within that period raise the score further.
+  if (valid && errorScore) {
+    errorDecay++;
+    if (errorDecay >= 4) {
+      errorDecay = 0;
+      errorScore--;
+    }
+  }
+}
+
+
+void RSbusHardware::countError(uint32_t &counter) {
+  rsCount(counter);
+  errorScore = (errorScore > 255 - 64) ? 255 : (errorScore + 64);
+}
+
+
+uint8_t RSbusHardware::fecLevel(void) {
+  // 0: no recent errors, 1: a single error in the last 256 cycles (or less), ... up to 4
+  return (errorScore + 63) >> 6;
+}
+
+
+//******************************************************************************************************
+// Error handling after a parity or pulse count error. Called by resetAddressPolled() of all variants
+void RSbusHardware::triggerRetransmission(uint8_t strategy, bool justTransmitted) {
+  // Retransmissions can be triggered by clearing the rsSignalIsOK flag.
+  // If this flag is cleared, checkConnection() sets the status to 'notSynchronised'
+  // empties the FIFO and clears the data2SendFlag.
+  // This will trigger the main sketch to retransmit (all 8 bits of) feedback data
+  // Strategy 3 avoids this: only the nibbles send in the errored cycle are send again, from the
+  // slot queues, and the connections remain synchronised
+  switch (strategy) {
+    case 0:                                  // Do nothing
+    break;
+    case 1:                                  // Signal an error if we just transmitted
+      if (justTransmitted) rsSignalIsOK = false;
+    break;
+    case 2:                                  // Always signal an error
+      rsSignalIsOK = false;                  // Will trigger a retransmission
+    break;
+    case 3:                                  // Only resend what was send in the errored cycle
+      if (justTransmitted && isr->sentLastCycle) {
+        if (isr->slotRequeue()) rsCount(telemetry.retransmissions);
+          else rsSignalIsOK = false;         // No space in a slot's queue: full retransmission
+      }
+    break;
+    default:                                 // Ignore
+    break;
+  }
+  // If the application will retransmit, we can cancel data ready for transmission
+  if (rsSignalIsOK == false) {
+    isr->data4IsrMask = 0;
+    rsCount(telemetry.retransmissions);
+  }
+}
+
+
+#if defined(RSBUS_STATISTICS)
+//******************************************************************************************************
+// Execution time statistics. See sup_stats.h
+void RSbusHardware::getStatistics(RSbusStatistics &copy) {
+  noInterrupts();                              // The ISR may update the statistics
+  copy = statistics;
+  interrupts();
+}
+
+
+void RSbusHardware::clearStatistics(void) {
+  RSbusTiming empty = {0xFFFF, 0, 0, 0};
+  noInterrupts();
+  statistics.isr = empty;
+  statistics.resetAddressPolled = empty;
+  statistics.checkPolling = empty;
+  statistics.checkConnection = empty;
+  interrupts();
+}
+#endif
+
 
 
 //******************************************************************************************************
@@ -71,45 +279,146 @@ const uint8_t NIBBLEBIT = 3;           // low or high order nibble
 const uint8_t TT_BIT_0  = 2;           // this bit must always be 0
 const uint8_t TT_BIT_1  = 1;           // this bit must always be 1
 const uint8_t PARITY    = 0;           // parity bit; will be calculated by software
+
+
+//******************************************************************************************************
+// Nibble encoding
+// Each RS-bus message (nibble) depends only on the decoder type, the nibble (high or low order bits)
+// and the 4 data bits. All 2 * 2 * 16 possible messages are therefore calculated by the compiler,
+// and stored in a table in flash. Encoding a nibble at run time is thereby a single flash read.
+// Note: least significant bit (LSB) first. Thus the parity bit comes first, immediately after the
+// USART's start bit. Because of this (unusual) order, the USART hardware can not calculate the
+// parity bit itself; such calculation must be done in software (here: by the compiler).
+// The functions below are C++11 constexpr, thus consist of a single return statement.
+constexpr uint8_t rsOddBits(uint8_t value) {    // 1 if value has an odd number of bits set
+  return (value == 0) ? 0 : ((value & 1) ^ rsOddBits(value >> 1));
+}
+
+constexpr uint8_t rsDataBits(uint8_t value) {   // The 4 data bits, in reversed order
+  return ((value & 0b00000001) << DATA_0)       // move bit 7 to bit 0 (distance = 7)
+       | ((value & 0b00000010) << (DATA_1 - 1)) // move bit 6 to bit 1 (distance = 5)
+       | ((value & 0b00000100) << (DATA_2 - 2)) // move bit 5 to bit 2 (distance = 3)
+       | ((value & 0b00001000) << (DATA_3 - 3)); // move bit 4 to bit 3 (distance = 1)
+}
+
+constexpr uint8_t rsTypeBits(Decoder_t type) {  // switch decoder with feedback, or feedback module
+  return (type == Switch) ? ((1 << TT_BIT_0) | (0 << TT_BIT_1)) : ((0 << TT_BIT_0) | (1 << TT_BIT_1));
+}
+
+constexpr uint8_t rsNibbleBit(Nibble_t nibble) {// low order nibble: 0, high order nibble: 1
+  return (nibble == LowBits) ? (0 << NIBBLEBIT) : (1 << NIBBLEBIT);
+}
+
+constexpr uint8_t rsAddParity(uint8_t value) {  // the parity bit makes the number of 1 bits odd
+  return value | (rsOddBits(value) ? (0 << PARITY) : (1 << PARITY));
+}
+
+constexpr uint8_t rsEncode(Decoder_t type, Nibble_t nibble, uint8_t value) {
+  return rsAddParity(rsDataBits(value) | rsNibbleBit(nibble) | rsTypeBits(type));
+}
+
+#define RS_ROW(type, nibble) {                                                       \
+  rsEncode(type, nibble,  0), rsEncode(type, nibble,  1), rsEncode(type, nibble,  2), \
+  rsEncode(type, nibble,  3), rsEncode(type, nibble,  4), rsEncode(type, nibble,  5), \
+  rsEncode(type, nibble,  6), rsEncode(type, nibble,  7), rsEncode(type, nibble,  8), \
+  rsEncode(type, nibble,  9), rsEncode(type, nibble, 10), rsEncode(type, nibble, 11), \
+  rsEncode(type, nibble, 12), rsEncode(type, nibble, 13), rsEncode(type, nibble, 14), \
+  rsEncode(type, nibble, 15)}
+
+// Indexed by [type][nibble][value]. Decoder_t: {Switch, Feedback}, Nibble_t: {HighBits, LowBits}
+const uint8_t rsEncodeTable[2][2][16] PROGMEM = {
+  {RS_ROW(Switch,   HighBits), RS_ROW(Switch,   LowBits)},
+  {RS_ROW(Feedback, HighBits), RS_ROW(Feedback, LowBits)}
+};
+#undef RS_ROW
+
+// Some spot checks, to ensure the table is the same as the messages used by previous versions
+static_assert(rsEncode(Feedback, LowBits,  0x0) == 0b00000010, "RS-bus encoding error");
+static_assert(rsEncode(Feedback, HighBits, 0xF) == 0b11111011, "RS-bus encoding error");
+static_assert(rsEncode(Switch,   LowBits,  0x1) == 0b10000101, "RS-bus encoding error");
+
+// Every connection object gets its own transmit slot in the RSbusIsr object of its bus. The slots
+// are handed out by the constructor, in the order in which the connection objects are instantiated.
+uint8_t RSbusConnection::slotsInUse[RSBUS_BUSES];
+RSbusConnection *RSbusConnection::connectionOfSlot[RSBUS_BUSES][RSBUS_MAX_SLOTS];
   
 
-RSbusConnection::RSbusConnection() {
-  // The following kind of RS-bus modules exist (see also http://www.der-moba.de/):
-  // - 0: accessory decoder without feedback
-  // - 1: accessory decoder with RS-Bus feedback
-  // - 2: feedback module for the RS-Bus (Default)
-  // - 3: Reserved for future use
-  // The 'type' is also conveyed in XpressNet response messages, and used for example
-  // by handhelds to indicate if a switch has feedback capabilities or if the feedback
-  // decoder is connected to the master station.
-  address = 0;                                 // Initialise to 0
-  type = Feedback;                             // Default value
-  status = notSynchronised;                    // state machine starts notSynchronised
-  feedbackRequested = false;                   // Initialise to false
-  forwardErrorCorrection = 0;                  // Default: no forward error correction
-}
-
-
-void RSbusConnection::format_nibble(uint8_t value) {
-  // Input is a byte, representing 4 feedback bits, plus one nibble bit
-  // 1) the routine sets the TT and parity bits
-  // 2) it stores the formatted byte in the FIFO
-  // Define the bits of the RS-bus `packet' (1 byte)
-  // Note: least significant bit (LSB) first. Thus the parity bit comes first,
-  // immediately after the USART's start bit. Because of this (unusual) order, the USART hardware
-  // can not calculate the parity bit itself; such calculation must be done in software.
-  unsigned char parity;
-  // Step 1A: set the `type' bit
-  if (type == Switch)   {value |= (1<<TT_BIT_0) | (0<<TT_BIT_1);}  // switch decoder with feedback
-  if (type == Feedback) {value |= (0<<TT_BIT_0) | (1<<TT_BIT_1);}  // feedback module
-  // Step 1B: Set the parity bit
-  parity = parity_even_bit(value);              // check parity
-  if (parity)                                   // if parity is even
-    {value |= (0<<PARITY);}                     // clear the parity bit
-    else {value |= (1<<PARITY);}                // set the parity bit
-  // Step 2: store the formatted `data byte' into the FIFO queue
-  // Data in this queue will later be send (using the USART) from send_nibble(). 
-  my_fifo.push(value);
+RSbusConnection::RSbusConnection(uint8_t bus) {
+  // The defaults of all attributes are in RSbus.h. Here the connection is bound to its bus
+  if (bus >= RSBUS_BUSES) bus = 0;             // This bus doesn't exist
+  hardware = rsHardwareOfBus[bus];
+  isr = rsIsrOfBus[bus];
+  // Claim a transmit slot. If all slots are in use, slotMask remains 0 and nothing will be send
+  slot = slotsInUse[bus];
+  if (slotsInUse[bus] < RSBUS_MAX_SLOTS) {
+    slotMask = (1 << slot);
+    connectionOfSlot[bus][slot] = this;
+    slotsInUse[bus]++;
+  }
+  else slotMask = 0;
+}
+
+
+uint8_t RSbusConnection::extraCopies(void) {
+  // In adaptive mode the number of copies follows the recent RS-bus error rate, but never exceeds
+  // forwardErrorCorrection. On a clean bus no copies are send at all.
+  if (!adaptiveFEC) return forwardErrorCorrection;
+  uint8_t level = hardware->fecLevel();
+  return (level < forwardErrorCorrection) ? level : forwardErrorCorrection;
+}
+
+
+//******************************************************************************************************
+// Backpressure. Instead of dropping nibbles that don't fit in the FIFO pool, the sketch may first
+// check if there is space. Per polling cycle the ISR sends at most one nibble of this connection.
+uint8_t RSbusConnection::queueDepth(void) {
+  uint8_t depth = (slotMask) ? isr->slotCount(slot) : 0;
+  if (coalesce) return depth + copiesLow + copiesHigh;
+  return depth + my_fifo.size();
+}
+
+
+uint8_t RSbusConnection::queueSpace(void) {
+  if (coalesce) return 255;                    // Newer values replace older values; nothing is dropped
+  return my_fifo.space(priority);
+}
+
+
+uint32_t RSbusConnection::drainTime(void) {
+  // Based on the measured cycle period; before that is known the nominal period is assumed:
+  // 130 pulses of 202us, plus 7ms of silence
+  noInterrupts();                              // A timer ISR may update the telemetry
+  uint32_t period = hardware->telemetry.periodAverage;
+  interrupts();
+  if (period == 0) period = 130UL * 202 + 7000;
+  return (queueDepth() * period) / 1000;
+}
+
+
+bool RSbusConnection::trySend4bits(Nibble_t nibble, uint8_t value) {
+  // All copies must fit, otherwise nothing is queued and the state remains unchanged
+  if (!coalesce && (queueSpace() < extraCopies() + 1)) return false;
+  send4bits(nibble, value);
+  return true;
+}
+
+
+bool RSbusConnection::trySend8bits(uint8_t value) {
+  // Same checks as send8bits(), to determine the number of nibbles that will be queued
+  if (!coalesce) {
+    uint8_t changed = (feedbackRequested || !lastValueValid) ? 0xFF : (value ^ lastValue);
+    uint8_t nibbles = ((changed & 0x0F) ? 1 : 0) + ((changed & 0xF0) ? 1 : 0);
+    if (queueSpace() < nibbles * (extraCopies() + 1)) return false;
+  }
+  send8bits(value);
+  return true;
+}
+
+
+uint8_t RSbusConnection::encode(Nibble_t nibble, uint8_t value) {
+  // Returns the complete RS-bus message (data bits, nibble bit, TT bits and parity bit) for
+  // the 4 lower order bits of value. The message is taken from the precomputed table.
+  return pgm_read_byte(&rsEncodeTable[(type == Switch) ? 0 : 1][(nibble == HighBits) ? 0 : 1][value & 0x0F]);
 }
 
 
@@ -118,17 +427,25 @@ void RSbusConnection::send4bits(Nibble_t nibble, uint8_t value) {
   // This nibble is later send to the RS-bus master station using sendnibble() 
   // nibble = 1..2, specifies if we use the first or the second nibble
   // data   = 0..15  
-  uint8_t data;
-  uint8_t nibbleValue;
-  if (nibble == LowBits) nibbleValue = 0;
-    else nibbleValue = 1;
-  data = ((value & 0b00000001) <<7)  // move bit 7 to bit 0 (distance = 7)
-       | ((value & 0b00000010) <<5)  // move bit 6 to bit 1 (distance = 5)
-       | ((value & 0b00000100) <<3)  // move bit 5 to bit 2 (distance = 3)
-       | ((value & 0b00001000) <<1)  // move bit 4 to bit 3 (distance = 1)
-       | (nibbleValue<<NIBBLEBIT);
+  // Remember the value, such that send8bits() can determine which nibbles did change
+  if (nibble == LowBits) lastValue = (lastValue & 0xF0) | (value & 0x0F);
+    else lastValue = (lastValue & 0x0F) | (value << 4);
+  knownHalves |= (nibble == LowBits) ? 0x01 : 0x02; // cachedResync needs both halves
+  if (coalesce) {
+    // Possible older values that are not send yet are overwritten
+    if (nibble == LowBits) copiesLow = extraCopies() + 1;
+      else copiesHigh = extraCopies() + 1;
+    freshHalves |= (nibble == LowBits) ? 0x01 : 0x02;
+    #if defined(RSBUS_LATENCY)
+    if (nibble == LowBits) stampLow = millis();
+      else stampHigh = millis();
+    #endif
+    return;
+  }
+  uint8_t data = encode(nibble, value);
   // If data should be send multiple times, store the same nibble multiple times
-  for (uint8_t i = 0; i <= forwardErrorCorrection; i++) {format_nibble(data);}
+  uint8_t copies = extraCopies();
+  for (uint8_t i = 0; i <= copies; i++) {push(data, i);}
 }
 
     
@@ -136,29 +453,86 @@ void RSbusConnection::send8bits(uint8_t value) {
   // Takes an 8 bit value to create two RS-bus nibbles and stores these nibbles in a FIFO 
   // These nibbles will later be send to the RS-bus master station using sendnibble() 
   // data = 0..255  
-  // Note that bit order should be changed.
-  const uint8_t NIBBLEBIT = 3;       // low or high order nibble
   uint8_t dataNibble1;
   uint8_t dataNibble2;
+  uint8_t changed;                   // The bits that differ from the previous value
+  // After a (re)synchronisation both nibbles must be send. Otherwise only the nibble(s) that changed
+  if (feedbackRequested || !lastValueValid) changed = 0xFF;
+    else changed = value ^ lastValue;
+  lastValue = value;
+  lastValueValid = true;
+  knownHalves = 0x03;                      // All 8 bits are known now
 // Sending 8 bits is sufficient to connect to the master
   feedbackRequested = false;
-  // send first nibble (for the low order bits
-  dataNibble1 = ((value & 0b00000001) <<7)  // move bit 7 to bit 0 (distance = 7)
-              | ((value & 0b00000010) <<5)  // move bit 6 to bit 1 (distance = 5)
-              | ((value & 0b00000100) <<3)  // move bit 5 to bit 2 (distance = 3)
-              | ((value & 0b00001000) <<1)  // move bit 4 to bit 3 (distance = 1)
-              | (0<<NIBBLEBIT);
-  // send second nibble (for the high order bits)
-  dataNibble2 = ((value & 0b00010000) <<3)  // move bit 3 to bit 0 (distance = 3)
-              | ((value & 0b00100000) <<1)  // move bit 2 to bit 1 (distance = 1)
-              | ((value & 0b01000000) >>1)  // move bit 1 to bit 2 (distance = -1)
-              | ((value & 0b10000000) >>3)  // move bit 0 to bit 3 (distance = -3)
-              | (1<<NIBBLEBIT);
+  if (coalesce) {
+    // Only remember the latest value. If both nibbles must be send, the low order bits go first
+    if (changed & 0x0F) copiesLow = extraCopies() + 1;
+    if (changed & 0xF0) copiesHigh = extraCopies() + 1;
+    if (changed & 0x0F) freshHalves |= 0x01;
+    if (changed & 0xF0) freshHalves |= 0x02;
+    if (changed == 0xFF) nextHalf = LowBits;
+    #if defined(RSBUS_LATENCY)
+    if (changed & 0x0F) stampLow = millis();
+    if (changed & 0xF0) stampHigh = millis();
+    #endif
+    return;
+  }
+  dataNibble1 = encode(LowBits, value);       // first nibble: the low order bits
+  dataNibble2 = encode(HighBits, value >> 4); // second nibble: the high order bits
   // If data should be send multiple times, store the same nibbles multiple times
-  for (uint8_t i = 0; i <= forwardErrorCorrection; i++) {
-    format_nibble(dataNibble1);
-    format_nibble(dataNibble2);
+  uint8_t copies = extraCopies();
+  for (uint8_t i = 0; i <= copies; i++) {
+    if (changed & 0x0F) push(dataNibble1, i);
+    if (changed & 0xF0) push(dataNibble2, i);
+  }
+}
+
+
+void RSbusConnection::push(uint8_t data, uint8_t copy) {
+  // Stores the nibble in the FIFO and maintains the telemetry. copy > 0: a FEC copy
+  if (!my_fifo.push(data, priority)) rsCount(hardware->telemetry.fifoOverflows);
+    else if (copy) rsCount(hardware->telemetry.fecCopies);
+}
+
+
+//******************************************************************************************************
+bool RSbusConnection::dataWaiting(void) {
+  if (coalesce) return ((copiesLow > 0) || (copiesHigh > 0));
+  return (my_fifo.size() > 0);
+}
+
+
+uint8_t RSbusConnection::nextData(void) {
+  // In the normal mode the oldest element is taken from the FIFO.
+  // In coalesce mode the nibble is formatted now, thus from the latest value. If both nibbles are
+  // waiting, they take turns, so a frequently changing nibble can not block the other nibble
+  if (!coalesce) {
+    #if defined(RSBUS_LATENCY)
+    stampNext = my_fifo.stampOldest();
+    #endif
+    return my_fifo.pop();
+  }
+  Nibble_t half = nextHalf;
+  if ((half == LowBits) && (copiesLow == 0)) half = HighBits;
+  if ((half == HighBits) && (copiesHigh == 0)) half = LowBits;
+  if (half == LowBits) {
+    if (!(freshHalves & 0x01)) rsCount(hardware->telemetry.fecCopies);
+    freshHalves &= ~0x01;
+    copiesLow--;
+    nextHalf = HighBits;
+    #if defined(RSBUS_LATENCY)
+    stampNext = stampLow;
+    #endif
+    return encode(LowBits, lastValue);
   }
+  if (!(freshHalves & 0x02)) rsCount(hardware->telemetry.fecCopies);
+  freshHalves &= ~0x02;
+  copiesHigh--;
+  nextHalf = LowBits;
+  #if defined(RSBUS_LATENCY)
+  stampNext = stampHigh;
+  #endif
+  return encode(HighBits, lastValue >> 4);
 }
 
 
@@ -166,12 +540,20 @@ void RSbusConnection::send8bits(uint8_t value) {
 uint8_t RSbusConnection::sendNibble(void) {
   // Perform the checks here, since this part is less time critical then the ISR part, which get its input from here
   uint8_t result = 0;                          // Function return value
-  if (my_fifo.size() > 0) {                    // We have data to send
-    if (rsISR.data2sendFlag == false) {        // And the USART (rs_interrupt routine) can accept new data
+  if (dataWaiting()) {                         // We have data to send
+    // In coalesce mode at most one nibble may wait in the slot's queue, since the nibble
+    // should be taken from the latest value as late as possible. Otherwise one place stays free,
+    // for the nibble that slotRequeue() may have to put back after an RS-bus error
+    uint8_t queueLimit = coalesce ? 1 : RSBUS_SLOT_QUEUE - 1;
+    if ((slotMask) && (isr->slotCount(slot) < queueLimit)) { // And our slot can accept new data
       if ((address > 0) && (address <= 128)) { // And the address for this connection has been initialized and is valid
-        rsISR.address2use = address;           // Use the address that belongs to this connection
-        rsISR.data2send = my_fifo.pop();       // Take the oldest element from the FIFO
-        rsISR.data2sendFlag = true;            // Tell the rs_interrupt routine that it should send data
+        isr->address2use[slot] = address;     // Use the address that belongs to this connection
+        uint8_t data = nextData();             // Take the oldest element from the FIFO, or latest value
+        #if defined(RSBUS_LATENCY)
+        isr->slotPush(slot, data, stampNext); // The ISR measures the latency once it sends the data
+        #else
+        isr->slotPush(slot, data);
+        #endif
         result = 1;                            // Succesfully presented the nibble to the rs_interrupt routine
       }
     }
@@ -182,13 +564,17 @@ uint8_t RSbusConnection::sendNibble(void) {
 
 void RSbusConnection::checkConnection(void) {
   // This function maintains the statemachine for the RS-bus connection, and should be called from main frequestly
-  if (rsbusHardware.rsSignalIsOK) {            // The decoder has received a polling cyclus (without errors)
+  RSBUS_STATS_START
+  if (hardware->rsSignalIsOK) {            // The decoder has received a polling cyclus (without errors)
     switch (status) {
       case notSynchronised :
         status = feedbackIsNeeded;             // status is used for our internal (private) statemachine
         feedbackRequested = true;              // used as external (public) flag towards main() and send8bits()
+        if (onFeedbackRequested) onFeedbackRequested(*this); // Normally calls send8bits()
         break;
       case feedbackIsNeeded:
+        // With cachedResync the connection answers itself, in the same call
+        if (feedbackRequested && cachedResync && (knownHalves == 0x03)) send8bits(lastValue);
         if (feedbackRequested == false) status = feedbackNibble1;
         break;
       case feedbackNibble1:
@@ -198,15 +584,170 @@ void RSbusConnection::checkConnection(void) {
         if (RSbusConnection::sendNibble()) status = connected;
         break;
       case connected:
-        RSbusConnection::sendNibble();
+        // Fill the slot's queue, so the ISR can continue sending if the main loop is busy
+        while (RSbusConnection::sendNibble()) {};
         break;
     }
   }
   else {
+    if (status != notSynchronised) rsCount(hardware->telemetry.resyncs);
     status = notSynchronised;                  // No RS-bus signal, or count / parity errors are detected
     my_fifo.empty();                           // Drop all data that is still waiting in the FIFO for transmission
-    rsISR.data2sendFlag = false;               // Cancel possible data waiting for ISR
+    copiesLow = 0;                             // Same for the latest value in coalesce mode
+    copiesHigh = 0;
+    lastValueValid = false;                    // The master must receive a full pair again
+    if (slotMask) isr->slotFlush(slot);       // Cancel possible data waiting in our slot's queue
+  }
+  RSBUS_STATS_STOP(checkConnection)
+}
+
+
+//******************************************************************************************************
+// Cached state. The last 8 feedback bits handed over are always remembered (lastValue). With
+// cachedResync these are send again by checkConnection() after a resynchronisation, thus after a
+// signal loss or a restart of the master, without waiting for the main sketch. setState() and
+// loadState() provide the initial value at power-up.
+void RSbusConnection::setState(uint8_t value) {
+  lastValue = value;
+  knownHalves = 0x03;                      // All 8 bits are known now
+}
+
+
+void RSbusConnection::loadState(uint16_t eepromAddress) {
+  setState(eeprom_read_byte((const uint8_t *)(uintptr_t) eepromAddress));
+}
+
+
+void RSbusConnection::saveState(uint16_t eepromAddress) {
+  // eeprom_update_byte() only writes if the value differs, which saves EEPROM write cycles.
+  // Still, the sketch should not call saveState() after every change of a frequently changing
+  // feedback bit, since an EEPROM cell supports roughly 100.000 write cycles.
+  eeprom_update_byte((uint8_t *)(uintptr_t) eepromAddress, lastValue);
+}
+
+
+#if defined(RSBUS_LATENCY)
+//******************************************************************************************************
+// Latency histogram. Maintained by the ISR, using our transmit slot. See sup_isr.h
+void RSbusConnection::getLatency(uint16_t histogram[RSBUS_LATENCY_BINS]) {
+  noInterrupts();                              // The ISR may update the histogram
+  for (uint8_t i = 0; i < RSBUS_LATENCY_BINS; i++) {
+    histogram[i] = (slotMask) ? isr->latency[slot][i] : 0;
   }
+  interrupts();
+}
+
+
+void RSbusConnection::clearLatency(void) {
+  if (!slotMask) return;
+  noInterrupts();
+  for (uint8_t i = 0; i < RSBUS_LATENCY_BINS; i++) isr->latency[slot][i] = 0;
+  interrupts();
 }
+#endif
 
    
+
+
+//******************************************************************************************************
+// The RSbusBank class serves a range of consecutive addresses with a single object. See RSbus.h
+//******************************************************************************************************
+RSbusBank *RSbusBank::bankOfSlot[RSBUS_BUSES][RSBUS_MAX_SLOTS];
+
+
+RSbusBank::RSbusBank(uint8_t addresses, uint8_t bus) {
+  if (bus >= RSBUS_BUSES) bus = 0;             // This bus doesn't exist
+  hardware = rsHardwareOfBus[bus];
+  isr = rsIsrOfBus[bus];
+  // Claim a transmit slot per address. If not enough slots are free, the bank gets none and
+  // nothing will be send
+  firstSlot = RSbusConnection::slotsInUse[bus];
+  if ((addresses > 0) && (addresses <= RSBUS_MAX_SLOTS - firstSlot)) {
+    numberOfAddresses = addresses;
+    bankOfSlot[bus][firstSlot] = this;
+    RSbusConnection::slotsInUse[bus] += addresses;
+  }
+  else numberOfAddresses = 0;
+}
+
+
+uint8_t RSbusBank::size(void) {
+  return numberOfAddresses;
+}
+
+
+uint8_t RSbusBank::encode(Nibble_t nibble, uint8_t value) {
+  return pgm_read_byte(&rsEncodeTable[(type == Switch) ? 0 : 1][(nibble == HighBits) ? 0 : 1][value & 0x0F]);
+}
+
+
+void RSbusBank::write(uint8_t index, uint8_t value) {
+  // Only the nibble(s) that changed are marked to be send
+  if (index >= numberOfAddresses) return;
+  uint8_t changed = value ^ state[index];
+  state[index] = value;
+  if (changed & 0x0F) dirty |= ((uint16_t)1U << (2 * index));
+  if (changed & 0xF0) dirty |= ((uint16_t)2U << (2 * index));
+}
+
+
+void RSbusBank::writeBit(uint8_t input, bool value) {
+  uint8_t index = input >> 3;
+  if (index >= numberOfAddresses) return;
+  uint8_t mask = (1 << (input & 0x07));
+  write(index, value ? (state[index] | mask) : (state[index] & ~mask));
+}
+
+
+uint8_t RSbusBank::read(uint8_t index) {
+  return (index < numberOfAddresses) ? state[index] : 0;
+}
+
+
+void RSbusBank::check(void) {
+  // Instead of the state machine of RSbusConnection, the bank relies on its state: after a
+  // (re)synchronisation all nibbles are marked to be send again, the low order nibbles first.
+  // Per address at most one nibble waits in the slot's queue, so the nibble is taken from the
+  // latest state. Only addresses with a nibble waiting are visited.
+  RSBUS_STATS_START
+  if (!hardware->rsSignalIsOK) {
+    if (synchronised) rsCount(hardware->telemetry.resyncs);
+    synchronised = false;
+    for (uint8_t i = 0; i < numberOfAddresses; i++) isr->slotFlush(firstSlot + i);
+  }
+  else if ((baseAddress > 0) && (baseAddress + numberOfAddresses <= 129)) {
+    if (!synchronised) {
+      synchronised = true;
+      dirty = (numberOfAddresses == 8) ? 0xFFFF : (((uint16_t)1U << (2 * numberOfAddresses)) - 1);
+      preferHigh = 0;
+    }
+    uint16_t pending = dirty;
+    while (pending) {
+      uint8_t index = __builtin_ctz(pending) >> 1;
+      uint8_t nibbles = (dirty >> (2 * index)) & 0x03;
+      pending &= ~((uint16_t)0x03U << (2 * index));
+      uint8_t slot = firstSlot + index;
+      if (isr->slotCount(slot) == 0) {
+        // If both nibbles are waiting they take turns, so a frequently changing nibble can not block the other
+        Nibble_t half = (nibbles == 0x01) ? LowBits : HighBits;
+        if ((nibbles == 0x03) && !(preferHigh & (1 << index))) half = LowBits;
+        uint8_t data = (half == LowBits) ? encode(LowBits, state[index]) : encode(HighBits, state[index] >> 4);
+        isr->address2use[slot] = baseAddress + index;
+        #if defined(RSBUS_LATENCY)
+        isr->slotPush(slot, data, millis());
+        #else
+        isr->slotPush(slot, data);
+        #endif
+        if (half == LowBits) {
+          dirty &= ~((uint16_t)1U << (2 * index));
+          preferHigh |= (1 << index);
+        }
+        else {
+          dirty &= ~((uint16_t)2U << (2 * index));
+          preferHigh &= ~(1 << index);
+        }
+      }
+    }
+  }
+  RSBUS_STATS_STOP(checkConnection)
+}
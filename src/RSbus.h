@@ -11,6 +11,22 @@
 //            2021-07-18 ap V1.1.1 USART can now be selected with number: 0, 1, 2 ...
 //            2021-07-26 ap v1.1.2 Default type is now 'Feedback decoder'
 //            2021-10-30 ap v2.0.0 Major rewrite of sup.isr*. Hardware decoding (RTC, TCB) added 
+//            2026-10-14 ag v2.5.0 All connections may send a nibble within the same polling cycle
+//                                 Coalescing mode: only the latest feedback value is send
+//                                 send8bits() only sends the nibble(s) that changed
+//                                 Nibble encoding via a precomputed table
+//                                 Optional execution time statistics (RSBUS_STATISTICS)
+//                                 Optional latency histogram per connection (RSBUS_LATENCY)
+//                                 Telemetry with 32 bit counters
+//                                 Adaptive forward error correction
+//                                 Error handling 3: selective retransmission of the errored nibbles
+//                                 Cached state: resynchronisation without the main sketch
+//                                 Up to three RS-bus interfaces (SW_TCBx)
+//                                 Optional event callbacks, and connections serviced by checkPolling()
+//                                 RSbusBank: a range of addresses served by a single object
+//                                 RSbusInputs: debounced input scanner (sup_inputs.h)
+//                                 TCA0 as pulse counter on any pin (HW_TCA0)
+//                                 Timer 1, 3, 4 or 5 as pulse counter on the Tn pin (HW_Tx)
 //
 // This Arduino library can be used to send feedback information from a decoder to the master
 // station via the (LENZ) RS-bus. The RS-bus is the standard feedback bus used for Lenz products,
@@ -42,25 +58,48 @@
 #include "sup_isr.h"
 #include "sup_usart.h"
 #include "sup_fifo.h"
+#include "sup_stats.h"
+#include "sup_inputs.h"
 
 
 //************************************************************************************************
 // The following types are defined as globals, so they can be used by the main program
+// The following kind of RS-bus modules exist (see also http://www.der-moba.de/):
+// - 0: accessory decoder without feedback
+// - 1: accessory decoder with RS-Bus feedback (Switch)
+// - 2: feedback module for the RS-Bus (Feedback, the default)
+// - 3: Reserved for future use
+// The 'type' is also conveyed in XpressNet response messages, and used for example
+// by handhelds to indicate if a switch has feedback capabilities or if the feedback
+// decoder is connected to the master station.
 enum Decoder_t { Switch, Feedback };
 enum Nibble_t  { HighBits, LowBits };
+class RSbusConnection;
+class RSbusBank;
+typedef void (*RSbusEvent)(void);                            // Callback of RSbusHardware
+typedef void (*RSbusConnectionEvent)(RSbusConnection &connection); // Callback of RSbusConnection
 
 //************************************************************************************************
 class RSbusHardware {
   public:
-    RSbusHardware();                          // The constructor for this class
+    RSbusHardware(uint8_t busNumber = 0);     // The constructor. busNumber: see RSBUS_BUS1_TCB
   
-    bool rsSignalIsOK;                        // Flag to indicate if the polling cyclus is error-free
-    bool interruptModeRising;                 // The interrupt triggers at the RISING edge (default: true)
-    bool swapUsartPin;                        // Enables the use of alternative USART pins (default: false)
-    volatile uint8_t parityErrors;            // Number of parity errors detected
-    volatile uint8_t pulseCountErrors;        // Number of pulse count errors detected
-    volatile uint8_t parityErrorHandling;     // 0..2. 0: no reaction, 1: only if just transmitted, 2: always
-    volatile uint8_t pulseCountErrorHandling; // 0..2. 0: no reaction, 1: only if just transmitted, 2: always
+    bool rsSignalIsOK = false;                // Flag to indicate if the polling cyclus is error-free
+    bool interruptModeRising = true;          // The interrupt triggers at the RISING edge (default: true)
+    bool swapUsartPin = false;                // Enables the use of alternative USART pins (default: false)
+    #if defined(RSBUS_USES_SW_TCB0) || defined(RSBUS_USES_SW_TCB1) || defined(RSBUS_USES_SW_TCB2) || \
+        defined(RSBUS_USES_SW_TCB3) || defined(RSBUS_USES_SW_TCB4)
+    uint8_t minPulsePeriod = 180;             // SW_TCBx: pulses within this time (us) are noise (default: 180)
+    uint8_t maxSendDelay = 100;               // SW_TCBx: later writes (us after the pulse) wait a cycle (default: 100)
+    #endif
+    volatile uint8_t parityErrors = 0;        // Number of parity errors detected
+    volatile uint8_t pulseCountErrors = 0;    // Number of pulse count errors detected
+    volatile uint8_t parityErrorHandling = 1; // 0..3. 0: no reaction, 1: only if just transmitted, 2: always, 3: resend nibble
+    volatile uint8_t pulseCountErrorHandling = 2; // 0..3. 0: no reaction, 1: only if just transmitted, 2: always, 3: resend nibble
+    bool serviceConnections = false;          // checkPolling() calls checkConnection() / check() of all connections and banks (default: false)
+    RSbusEvent onSignalOk = 0;                // Called by checkPolling() once rsSignalIsOK becomes true (default: none)
+    RSbusEvent onSignalLost = 0;              // Called by checkPolling() once rsSignalIsOK becomes false (default: none)
+    RSbusEvent onNibbleSent = 0;              // Called by checkPolling() after the ISR did send nibble(s) (default: none)
   
     void attach(                              // Initialises the RS-bus ISR
       uint8_t usartNumber,                    // usart for sending (0..4)
@@ -68,6 +107,16 @@ class RSbusHardware {
    
     void detach(void);                        // stops the RS-bus ISR
     void checkPolling(void);                  // Checks every 2ms the polling logic of the RS-bus receiver.
+    RSbusTelemetry telemetry;                 // 32 bit counters of bus events. See sup_stats.h
+    void getTelemetry(RSbusTelemetry &copy);  // Copies telemetry, with interrupts disabled
+    void clearTelemetry(void);                // Sets all telemetry counters to 0
+    uint8_t fecLevel(void);                   // 0..4. Extra copies needed, given the recent error rate
+
+    #if defined(RSBUS_STATISTICS)             // See sup_stats.h
+    RSbusStatistics statistics;               // Execution times of the ISR and the main loop functions
+    void getStatistics(RSbusStatistics &copy);// Copies statistics, with interrupts disabled
+    void clearStatistics(void);               // Restarts the measurements
+    #endif
   
     // There is no need to call the following, since it is already called by checkPolling or a timer
     // However, it needs to be accessable globally to allow access by the timer ISR.
@@ -75,26 +124,48 @@ class RSbusHardware {
   
   private:
     int rxPinUsed;                            // local copy of pin used for sending, using the USART
+    uint8_t bus;                              // 0..RSBUS_BUSES-1. The RS-bus served by this object
+    volatile RSbusIsr *isr;                   // The ISR administration of that bus
+    bool parityPending = false;               // 8ms of silence. A parity error, unless it becomes 12ms
+    bool cycleValid = false;                  // The current polling cycle started after a valid cycle
+    unsigned long tCycleStart = 0;            // Time in microsec the current polling cycle started
+    void cycleStarted(bool valid);            // Telemetry: a period of silence ended the previous cycle
+    uint8_t errorScore = 0;                   // Recent RS-bus errors: +64 per error, -1 per 4 valid cycles
+    uint8_t errorDecay = 0;                   // Counts valid cycles, to lower errorScore
+    void countError(uint32_t &counter);       // Telemetry and errorScore: a parity or pulse count error
+    unsigned long tLastEvents = 0;            // Time in microsec of the previous checkEvents()
+    bool signalReported = false;              // rsSignalIsOK, as reported by the previous callback
+    uint32_t nibblesReported;                 // nibblesSent, as seen by the previous onNibbleSent check
+    void checkEvents(void);                   // Called by checkPolling: callbacks and serviceConnections
     void triggerRetransmission(               // May set rsSignalIsOK to false, which triggers retransmission
-      uint8_t strategy,                       // 0 = never, 1 = if just transmitted, 2 = always
+      uint8_t strategy,                       // 0 = never, 1 = if just transmitted, 2 = always, 3 = resend
       boolean dataWasSendFlag                 // for strategy = 1
     );
     void initTcb(void);                       // For the TCB variants
-    void initEventSystem(uint8_t rxPin);      // For the TCB variants
-    void init_timerx(void);                   // In case we have an ATMega 2560 processor
-    void stop_timerx(void);                   // In case we have an ATMega 2560 processor
+    void initEventSystem(uint8_t rxPin);      // For the HW_TCBx and HW_TCA0 variants
+    void init_timerx(void);                   // In case we have an ATMega 2560 processor, or a silence timer
+    void stop_timerx(void);                   // In case we have an ATMega 2560 processor, or a silence timer
 };
 
 
 //************************************************************************************************
 class RSbusConnection {
   public:
-    RSbusConnection();                  // The constructor for this class
+    RSbusConnection(uint8_t bus = 0);   // The constructor. bus: the RS-bus interface (see RSBUS_BUS1_TCB)
 
-    uint8_t address;                    // 1..128. The address used for this RS-bus connection
-    uint8_t forwardErrorCorrection;     // 0..2. 0 = no retransmission, 1 = one retransmission, 2 = two ...
-    bool feedbackRequested;             // A flag signalling the main program that it should send 8 feedback bits
-    Decoder_t type;                     // Do we send Switch or Feedback messages? Default: Switch
+    #if defined(RSBUS_FIXED_ADDRESS)
+    uint8_t address = RSBUS_FIXED_ADDRESS; // The ISR only serves this address
+    #else
+    uint8_t address = 0;                // 1..128. The address used for this RS-bus connection
+    #endif
+    uint8_t forwardErrorCorrection = 0; // 0..2. 0 = no retransmission, 1 = one retransmission, 2 = two ...
+    bool feedbackRequested = false;     // A flag signalling the main program that it should send 8 feedback bits
+    Decoder_t type = Feedback;          // Do we send Switch or Feedback messages? Default: Feedback
+    bool coalesce = false;              // Send only the latest value, instead of every queued value
+    bool adaptiveFEC = false;           // Copies depend on the bus error rate; forwardErrorCorrection is the maximum
+    bool cachedResync = false;          // Answer feedbackRequested with the last known 8 bits, without main()
+    RSbusConnectionEvent onFeedbackRequested = 0; // Called by checkConnection() once feedbackRequested is set
+    uint8_t priority = 0;               // 0..7. Higher priorities get FIFO pool space first (default: 0)
 
                                      
     void send4bits(                     // Sends a single message (nibble) to the master station
@@ -106,13 +177,50 @@ class RSbusConnection {
       uint8_t value                     // 0..255, which means we send 2 RS-bus messages
     );
 
+    bool trySend4bits(Nibble_t nibble, uint8_t value); // Same as send4bits(), but false if it doesn't fit
+    bool trySend8bits(uint8_t value);   // Same as send8bits(), but false if it doesn't fit
+    uint8_t queueDepth(void);           // Number of nibbles waiting to be send
+    uint8_t queueSpace(void);           // Number of nibbles that can still be queued (coalesce: 255)
+    uint32_t drainTime(void);           // Estimated time (ms) until all waiting nibbles are send
+
     void checkConnection(void);         // checks if data is waiting in the FIFO queue. If yes,
                                         // calls sendNibble to handle that data to the RS-bus ISR. 
+    void setState(uint8_t value);       // Sets the last known 8 feedback bits, without sending them
+    void loadState(uint16_t eepromAddress); // Same, but the value is read from EEPROM
+    void saveState(uint16_t eepromAddress); // Writes the last known 8 feedback bits to EEPROM
+    #if defined(RSBUS_LATENCY)          // See sup_isr.h
+    void getLatency(uint16_t histogram[RSBUS_LATENCY_BINS]); // Copies the latency histogram
+    void clearLatency(void);            // Restarts the latency measurements
+    #endif
 
   private:
+    RSbusHardware *hardware;            // The RS-bus interface this connection is bound to
+    volatile RSbusIsr *isr;             // The ISR administration of that interface
     FIFO my_fifo;                       // FIFO queue that can store a number of nibbles
+    uint8_t lastValue = 0;              // The latest 8 feedback bits handed over for transmission
+    bool lastValueValid = false;        // False until the master received a full pair (after a resync)
+    uint8_t knownHalves = 0;            // Bit 0 (low) / 1 (high): lastValue holds these bits. 0x03: cachedResync possible
+    uint8_t copiesLow = 0;              // coalesce: number of times the low nibble should still be send
+    uint8_t copiesHigh = 0;             // coalesce: number of times the high nibble should still be send
+    uint8_t freshHalves = 0;            // coalesce: bit 0 (low) / 1 (high) set until the first copy is send
+    Nibble_t nextHalf = LowBits;        // coalesce: the nibble that has preference for the next slot
+    #if defined(RSBUS_LATENCY)
+    uint16_t stampLow = 0;              // coalesce: millis() when the low nibble was handed over
+    uint16_t stampHigh = 0;             // coalesce: millis() when the high nibble was handed over
+    uint16_t stampNext = 0;             // Timestamp of the nibble returned by nextData()
+    #endif
+    uint8_t slot;                       // The transmit slot (0..RSBUS_MAX_SLOTS-1) of this connection
+    uint8_t slotMask;                   // The bit for this slot in data2sendMask / data4IsrMask
+    static uint8_t slotsInUse[RSBUS_BUSES]; // Per bus the number of transmit slots handed out
+    static RSbusConnection *connectionOfSlot[RSBUS_BUSES][RSBUS_MAX_SLOTS]; // For serviceConnections
+    friend class RSbusHardware;         // checkEvents() services the connections of its bus
+    friend class RSbusBank;             // A bank claims its slots from slotsInUse as well
     uint8_t sendNibble(void);           // Called by checkConnection to send a nibble from the FIFO  
-    void format_nibble(uint8_t value);  // To set the decoder type and the parity bit
+    void push(uint8_t data, uint8_t copy); // Stores a nibble in the FIFO. copy > 0: FEC copy
+    uint8_t extraCopies(void);          // Number of FEC copies to add to a nibble
+    bool dataWaiting(void);             // Is there a nibble waiting, in the FIFO or as latest value?
+    uint8_t nextData(void);             // Takes the next formatted nibble from the FIFO or latest value
+    uint8_t encode(Nibble_t nibble, uint8_t value); // Table lookup of the complete RS-bus message
 
     enum Status {                       // The state machine that is maintained for each connection
       notSynchronised,
@@ -120,5 +228,43 @@ class RSbusConnection {
       feedbackNibble1,
       feedbackNibble2,
       connected
-    } status;
+    } status = notSynchronised;         // The state machine starts notSynchronised
+};
+
+
+//************************************************************************************************
+// A bank serves a range of consecutive RS-bus addresses, for example an occupancy detector with
+// 64 inputs (8 addresses). Instead of a RSbusConnection object per address, each with its own FIFO
+// and state machine, the bank only stores 8 feedback bits per address and a bit per nibble that
+// still has to be send. Each address has its own transmit slot, thus per polling cycle every address
+// can send a nibble.
+class RSbusBank {
+  public:
+    RSbusBank(uint8_t addresses, uint8_t bus = 0); // addresses: 1..RSBUS_MAX_SLOTS. bus: see RSBUS_BUS1_TCB
+
+    #if defined(RSBUS_FIXED_ADDRESS)
+    uint8_t baseAddress = RSBUS_FIXED_ADDRESS; // The ISR only serves this address
+    #else
+    uint8_t baseAddress = 0;            // 1..128. The address of the first byte
+    #endif
+    Decoder_t type = Feedback;          // Do we send Switch or Feedback messages? Default: Feedback
+
+    void write(uint8_t index, uint8_t value); // The 8 feedback bits of address baseAddress + index
+    void writeBit(uint8_t input, bool value); // A single feedback bit, input 0..(8 * size() - 1)
+    uint8_t read(uint8_t index);        // The 8 feedback bits of address baseAddress + index
+    uint8_t size(void);                 // The number of addresses. 0 if not enough slots were free
+    void check(void);                   // Hands the changed nibbles to the ISR. Call from main frequently
+
+  private:
+    RSbusHardware *hardware;            // The RS-bus interface this bank is bound to
+    volatile RSbusIsr *isr;             // The ISR administration of that interface
+    uint8_t state[RSBUS_MAX_SLOTS] = {}; // Per address the 8 feedback bits
+    uint16_t dirty = 0;                 // Per address 2 bits: low (bit 2i) and high (bit 2i+1) nibble waiting
+    uint8_t preferHigh = 0;             // Per address: the high nibble goes first, if both are waiting
+    uint8_t numberOfAddresses;          // Number of addresses (and slots) of this bank
+    uint8_t firstSlot;                  // The slot of baseAddress. The other addresses use the next slots
+    bool synchronised = false;          // The master received all 8 bits of every address
+    uint8_t encode(Nibble_t nibble, uint8_t value); // Table lookup of the complete RS-bus message
+    static RSbusBank *bankOfSlot[RSBUS_BUSES][RSBUS_MAX_SLOTS]; // For serviceConnections
+    friend class RSbusHardware;         // checkEvents() services the banks of its bus
 };
@@ -17,6 +17,13 @@
 //            2021-12-13 ap V1.1 Restructured, and selects TCB3 as default when possible
 //            2022-02-05 ap V1.2 For ATMega 2560 selects Timer 3 as default (4&5 are alternatives)
 //            2022-07-27 ap V1.3 Timer 1 is now possible as well
+//            2026-10-14 ag V1.4 Optional timer driven silence detection for DxCore and MegaCoreX
+//                               Optional pin change interrupt vectors for RSBUS_USES_SW and SW_Tx
+//                               Optional execution time statistics and latency histograms
+//                               Up to three RS-bus interfaces with the SW_TCBx variant
+//                               Optional fixed RS-bus address
+//                               TCA0 as event counter for MegaCoreX and DxCore (HW_TCA0)
+//                               Timer 1, 3, 4 or 5 as pulse counter for traditional ATMega processors (HW_Tx)
 //
 // For different ATmega controllers different RS-bus routines exist
 //
@@ -38,6 +45,25 @@
 // However, also other ATMega processors that support at least one 16-bit Timer can select this
 // variant.
 //
+// RSBUS_USES_HW_Tx (V2.5)
+// =======================
+// Traditional ATMega processors can count the RS-bus pulses in hardware as well: a 16-bit Timer is
+// clocked by its external clock input pin (Tn), and raises a compare match interrupt once the
+// RS-bus address is reached. Instead of 130 interrupts per polling cycle, a single interrupt per
+// address that has data waiting remains, which frees almost all CPU time the RS-bus takes. The
+// disadvantage is that the RS-bus input MUST be connected to the Tn pin of the selected timer: on the
+// 328 (UNO, Nano) Timer 1 with T1 = PD5 (pin 5), on the Arduino Mega Timer 5 with T5 = PL2 (pin 47).
+// Since the timer counts pulses, the main loop MUST call checkPolling() at least every 2ms.
+// Timer 1 is also used by the Servo library, tone() and analogWrite() on pins 9 and 10.
+//
+// RSBUS_SW_PCINT (V2.5)
+// =====================
+// Can be added to RSBUS_USES_SW or RSBUS_USES_SW_Tx on traditional ATMega processors. Instead of
+// attachInterrupt(), the Pin Change Interrupt vectors are used directly. This avoids the overhead of
+// the function pointer call within the Arduino core, and thereby reduces the time per RS-bus pulse
+// and the interrupt latency for other ISRs, like those of a DCC decoder. Any pin can be used.
+// Can not be combined with other libraries that use Pin Change Interrupts, such as SoftwareSerial.
+//
 // RSBUS_USES_SW_TCBx (V2)
 // =======================
 // For AtMegaX and DxCore processors a more efficient and reliable approach is to replace the
@@ -68,13 +94,51 @@
 // or earlier processors. Like the RTC approach, this approach puts limited load on the CPU, 
 // but as opposed to the RTC approach we have (more) freedom in choosing the RS-bus input pin.
 //  
+// RSBUS_USES_HW_TCA0 (V2.5)
+// =========================
+// Also MegaCoreX processors can count the RS-bus pulses in hardware, with a free choice of the input
+// pin: the Event System routes the RS-bus input to TCA0, which counts the events and raises a compare
+// match interrupt once the RS-bus address is reached. Like the RTC and HW_TCBx approaches, this
+// approach puts limited load on the CPU. TCA0 is taken from the Arduino core, which uses it for PWM;
+// analogWrite() on the TCA0 pins therefore no longer works.
+//
 // RSBUS_USES_SW_4MS (V1)
 // ======================
 // This is an older version of the default approach. Instead of checking every 2ms for a period
 // of silence, we check every 4ms. This may be slightly more efficient, but doesn't allow the
 // detection of parity errors.
 //
+// RSBUS_SILENCE_TCBx / RSBUS_SILENCE_PIT (V2.5)
+// =============================================
+// The RTC, SW_TCBx, HW_TCBx and HW_TCA0 variants need checkPolling() to be called by the main loop at
+// least every 2ms, to detect the period of silence between polling cycles. Similar to RSBUS_USES_SW_Tx,
+// a spare timer can take over that task on DxCore and MegaCoreX processors. The timer raises an
+// interrupt every 2ms that calls resetAddressPolled(); checkPolling() therefore does nothing anymore.
+// Either a TCB that is not used by the RS-bus code itself can be selected, or the Periodic Interrupt
+// Timer (PIT) of the RTC. The PIT can not be used in combination with RSBUS_USES_RTC.
+// Make sure the selected timer is not used by other libraries or by millis() / micros().
+//
+// RSBUS_BUS1_TCB / RSBUS_BUS2_TCB (V2.5)
+// ======================================
+// With the SW_TCBx variant, a single decoder can serve up to three separate RS-buses. The RS-bus
+// selected with RSBUS_USES_SW_TCBx is bus 0, which is served by rsbusHardware. RSBUS_BUS1_TCB and
+// RSBUS_BUS2_TCB select the TCB (0..4) for bus 1 and bus 2, which are served by rsbusHardware1 and
+// rsbusHardware2. Each bus gets its own ISR, receive pin and USART (the parameters of attach()), and
+// its own transmit slots. A connection is bound to a bus by its constructor: RSbusConnection rsbus(1);
+// The main loop should call checkPolling() of every bus; a silence timer can not be used.
+// In case of RSBUS_STATISTICS, the execution times of all buses are combined.
+//
+// RSBUS_FIXED_ADDRESS (V2.5)
+// ==========================
+// For decoders with a single RS-bus address that is known at compile time. The address becomes a
+// constant, so the software based ISRs (SW, SW_Tx, SW_TCBx and SW_4MS) compare the polled address
+// against an immediate value, and only have to check a single transmit slot. The decoder can then use
+// a single RSbusConnection object, whose address is set to RSBUS_FIXED_ADDRESS by its constructor;
+// RSBUS_MAX_SLOTS becomes 1, which also saves RAM. With the RTC, HW_TCBx, HW_TCA0 and HW_Tx variants
+// the address is already handled by the hardware; for these variants only the RAM is saved.
+//
 //************************************************************************************************
+#pragma once
 // To use alternative RS-bus code, uncomment ONE of the following lines. 
 // #define RSBUS_USES_SW            // Pin ISR for pulse count, default for traditional Arduino's
 // #define RSBUS_USES_RTC           // DxCore and MegaCoreX
@@ -86,12 +150,22 @@
 // #define RSBUS_USES_SW_T4         // Pin ISR for pulse count, Timer instead of checkPolling()
 // #define RSBUS_USES_SW_T5         // Pin ISR for pulse count, Timer instead of checkPolling()
 
+// Traditional ATMega processors, Timer counts the pulses on its Tn pin (instead of rxPin):
+// #define RSBUS_USES_HW_T1         // T1 pin: PD5 on the 328 (UNO, Nano pin 5), PD6 on the 2560 and 32U4
+// #define RSBUS_USES_HW_T3         // T3 pin: PE6 (not available on the Arduino Mega board)
+// #define RSBUS_USES_HW_T4         // T4 pin: PH7 (not available on the Arduino Mega board)
+// #define RSBUS_USES_HW_T5         // T5 pin: PL2 (Arduino Mega pin 47)
+
+// Traditional ATMega processors, in combination with RSBUS_USES_SW or RSBUS_USES_SW_Tx:
+// #define RSBUS_SW_PCINT           // Pin Change Interrupt vector instead of attachInterrupt()
+
 // DxCore and MegaCoreX:
 // #define RSBUS_USES_SW_TCB0       // The default version AP_DCC_Library also uses TCB0
 // #define RSBUS_USES_SW_TCB1       // The default version of the servo library also uses TCB1
 // #define RSBUS_USES_SW_TCB2       // The default version DxCore uses TCB2 for millis() / micros()
 // #define RSBUS_USES_SW_TCB3       // Only available on 48 and 64 pin DxCore processors
 // #define RSBUS_USES_SW_TCB4       // Only available on 64 pin DxCore processors
+// #define RSBUS_USES_HW_TCA0       // Hardware pulse count on any pin. TCA0 is no longer available for PWM
 
 // DxCore only:
 // #define RSBUS_USES_HW_TCB0       // The default version AP_DCC_Library also uses TCB0
@@ -101,13 +175,39 @@
 // #define RSBUS_USES_HW_TCB4       // Only available on 64 pin DxCore processors
 
 
+// DxCore and MegaCoreX, optional timer for the RTC, SW_TCBx, HW_TCBx and HW_TCA0 variants:
+// #define RSBUS_SILENCE_TCB0       // Instead of checkPolling(), TCB0 calls resetAddressPolled()
+// #define RSBUS_SILENCE_TCB1       // Instead of checkPolling(), TCB1 calls resetAddressPolled()
+// #define RSBUS_SILENCE_TCB2       // Instead of checkPolling(), TCB2 calls resetAddressPolled()
+// #define RSBUS_SILENCE_TCB3       // Instead of checkPolling(), TCB3 calls resetAddressPolled()
+// #define RSBUS_SILENCE_TCB4       // Instead of checkPolling(), TCB4 calls resetAddressPolled()
+// #define RSBUS_SILENCE_PIT        // Instead of checkPolling(), the RTC PIT calls resetAddressPolled()
+
+
+// DxCore and MegaCoreX, additional RS-bus interfaces for the SW_TCBx variant:
+// #define RSBUS_BUS1_TCB 1         // Bus 1 (rsbusHardware1) uses TCB1
+// #define RSBUS_BUS2_TCB 4         // Bus 2 (rsbusHardware2) uses TCB4
+
+
+// Decoders with a single RS-bus address that is known at compile time (1..128):
+// #define RSBUS_FIXED_ADDRESS 10   // Smallest and fastest ISR. A single RSbusConnection object
+
+
+// Development: measure the execution times of the ISR and main loop functions (see sup_stats.h)
+// #define RSBUS_STATISTICS         // Minimum, maximum and average times in rsbusHardware.statistics
+// #define RSBUS_LATENCY            // Per connection a histogram of the nibble latencies (see sup_isr.h)
+
+
 // If none of the above alternatives was selected, we use a default version
 #if !defined(RSBUS_USES_SW)      && !defined(RSBUS_USES_SW_4MS)  && !defined(RSBUS_USES_RTC) && \
+    !defined(RSBUS_USES_SW_T1)   && \
     !defined(RSBUS_USES_SW_T3)   && !defined(RSBUS_USES_SW_T4)   && !defined(RSBUS_USES_SW_T5) && \
+    !defined(RSBUS_USES_HW_T1)   && !defined(RSBUS_USES_HW_T3)   && \
+    !defined(RSBUS_USES_HW_T4)   && !defined(RSBUS_USES_HW_T5)   && \
     !defined(RSBUS_USES_SW_TCB0) && !defined(RSBUS_USES_SW_TCB1) && !defined(RSBUS_USES_SW_TCB2) && \
     !defined(RSBUS_USES_SW_TCB3) && !defined(RSBUS_USES_SW_TCB4) && \
     !defined(RSBUS_USES_HW_TCB0) && !defined(RSBUS_USES_HW_TCB1) && !defined(RSBUS_USES_HW_TCB2) && \
-    !defined(RSBUS_USES_HW_TCB3) && !defined(RSBUS_USES_HW_TCB4)
+    !defined(RSBUS_USES_HW_TCB3) && !defined(RSBUS_USES_HW_TCB4) && !defined(RSBUS_USES_HW_TCA0)
 
   // For DxCore processors with 40 pins or higher, the default is TCB3.
   // For MegaCoreX processors with 40 pins or higher, the default is TCB2.
@@ -175,21 +275,136 @@
   #ifndef TCB4_CNT
   #error "The selected RS-bus code does not run on this hardware"
   #endif
-#elif defined(RSBUS_USES_SW_T3)
+#elif defined(RSBUS_USES_HW_TCA0)
+  #ifndef TCA0
+  #error "The selected RS-bus code does not run on this hardware"
+  #endif
+#elif defined(RSBUS_USES_SW_T1) || defined(RSBUS_USES_HW_T1)
+  #ifndef TCNT1
+  #error "The selected RS-bus code does not run on this hardware"
+  #endif
+#elif defined(RSBUS_USES_SW_T3) || defined(RSBUS_USES_HW_T3)
   #ifndef TCNT3
   #error "The selected RS-bus code does not run on this hardware"
   #endif
-#elif defined(RSBUS_USES_SW_T4)
+#elif defined(RSBUS_USES_SW_T4) || defined(RSBUS_USES_HW_T4)
   #ifndef TCNT4
   #error "The selected RS-bus code does not run on this hardware"
   #endif
-#elif defined(RSBUS_USES_SW_T5)
+#elif defined(RSBUS_USES_SW_T5) || defined(RSBUS_USES_HW_T5)
   #ifndef TCNT5
   #error "The selected RS-bus code does not run on this hardware"
   #endif
 #endif
 
+#if defined(RSBUS_SW_PCINT)
+  #if !defined(RSBUS_USES_SW) && !defined(RSBUS_USES_SW_T1) && !defined(RSBUS_USES_SW_T3) && \
+      !defined(RSBUS_USES_SW_T4) && !defined(RSBUS_USES_SW_T5)
+  #error "RSBUS_SW_PCINT can only be used with RSBUS_USES_SW and RSBUS_USES_SW_Tx"
+  #endif
+  #ifndef PCICR
+  #error "RSBUS_SW_PCINT does not run on this hardware"
+  #endif
+#endif
 
+
+//************************************************************************************************
+// Check if the selected silence timer can be used
+//************************************************************************************************
+#if defined(RSBUS_SILENCE_TCB0) || defined(RSBUS_SILENCE_TCB1) || defined(RSBUS_SILENCE_TCB2) || \
+    defined(RSBUS_SILENCE_TCB3) || defined(RSBUS_SILENCE_TCB4) || defined(RSBUS_SILENCE_PIT)
+  #define RSBUS_SILENCE_TIMER
+  #if !defined(RSBUS_USES_RTC) && \
+      !defined(RSBUS_USES_SW_TCB0) && !defined(RSBUS_USES_SW_TCB1) && !defined(RSBUS_USES_SW_TCB2) && \
+      !defined(RSBUS_USES_SW_TCB3) && !defined(RSBUS_USES_SW_TCB4) && \
+      !defined(RSBUS_USES_HW_TCB0) && !defined(RSBUS_USES_HW_TCB1) && !defined(RSBUS_USES_HW_TCB2) && \
+      !defined(RSBUS_USES_HW_TCB3) && !defined(RSBUS_USES_HW_TCB4) && !defined(RSBUS_USES_HW_TCA0)
+  #error "A silence timer can only be used with the RTC, SW_TCBx, HW_TCBx and HW_TCA0 variants"
+  #endif
+#endif
+
+#if (defined(RSBUS_SILENCE_TCB0) && (defined(RSBUS_USES_SW_TCB0) || defined(RSBUS_USES_HW_TCB0))) || \
+    (defined(RSBUS_SILENCE_TCB1) && (defined(RSBUS_USES_SW_TCB1) || defined(RSBUS_USES_HW_TCB1))) || \
+    (defined(RSBUS_SILENCE_TCB2) && (defined(RSBUS_USES_SW_TCB2) || defined(RSBUS_USES_HW_TCB2))) || \
+    (defined(RSBUS_SILENCE_TCB3) && (defined(RSBUS_USES_SW_TCB3) || defined(RSBUS_USES_HW_TCB3))) || \
+    (defined(RSBUS_SILENCE_TCB4) && (defined(RSBUS_USES_SW_TCB4) || defined(RSBUS_USES_HW_TCB4))) || \
+    (defined(RSBUS_SILENCE_PIT) && defined(RSBUS_USES_RTC))
+  #error "The silence timer is already used by the selected RS-bus code"
+#endif
+
+#if defined(RSBUS_SILENCE_TCB0)
+  #ifndef TCB0_CNT
+  #error "The selected silence timer does not exist on this hardware"
+  #endif
+#elif defined(RSBUS_SILENCE_TCB1)
+  #ifndef TCB1_CNT
+  #error "The selected silence timer does not exist on this hardware"
+  #endif
+#elif defined(RSBUS_SILENCE_TCB2)
+  #ifndef TCB2_CNT
+  #error "The selected silence timer does not exist on this hardware"
+  #endif
+#elif defined(RSBUS_SILENCE_TCB3)
+  #ifndef TCB3_CNT
+  #error "The selected silence timer does not exist on this hardware"
+  #endif
+#elif defined(RSBUS_SILENCE_TCB4)
+  #ifndef TCB4_CNT
+  #error "The selected silence timer does not exist on this hardware"
+  #endif
+#endif
+
+
+
+//************************************************************************************************
+// Multiple RS-bus interfaces
+//************************************************************************************************
+#if defined(RSBUS_BUS2_TCB) && !defined(RSBUS_BUS1_TCB)
+  #error "RSBUS_BUS2_TCB requires RSBUS_BUS1_TCB"
+#elif defined(RSBUS_BUS2_TCB)
+  #define RSBUS_BUSES 3
+#elif defined(RSBUS_BUS1_TCB)
+  #define RSBUS_BUSES 2
+#else
+  #define RSBUS_BUSES 1
+#endif
+
+#if defined(RSBUS_USES_SW_TCB0)
+  #define RSBUS_BUS0_TCB 0
+#elif defined(RSBUS_USES_SW_TCB1)
+  #define RSBUS_BUS0_TCB 1
+#elif defined(RSBUS_USES_SW_TCB2)
+  #define RSBUS_BUS0_TCB 2
+#elif defined(RSBUS_USES_SW_TCB3)
+  #define RSBUS_BUS0_TCB 3
+#elif defined(RSBUS_USES_SW_TCB4)
+  #define RSBUS_BUS0_TCB 4
+#endif
+
+#if (RSBUS_BUSES > 1)
+  #if !defined(RSBUS_BUS0_TCB)
+  #error "Multiple RS-bus interfaces can only be used with the SW_TCBx variant"
+  #endif
+  #if defined(RSBUS_SILENCE_TIMER)
+  #error "A silence timer can not be used with multiple RS-bus interfaces"
+  #endif
+  #if (RSBUS_BUS1_TCB == RSBUS_BUS0_TCB)
+  #error "RSBUS_BUS1_TCB is already used by RS-bus 0"
+  #endif
+#endif
+#if defined(RSBUS_FIXED_ADDRESS)
+  #if (RSBUS_FIXED_ADDRESS < 1) || (RSBUS_FIXED_ADDRESS > 128)
+  #error "RSBUS_FIXED_ADDRESS should be 1..128"
+  #endif
+  #if (RSBUS_BUSES > 1)
+  #error "RSBUS_FIXED_ADDRESS can not be used with multiple RS-bus interfaces"
+  #endif
+#endif
+#if (RSBUS_BUSES > 2)
+  #if (RSBUS_BUS2_TCB == RSBUS_BUS0_TCB) || (RSBUS_BUS2_TCB == RSBUS_BUS1_TCB)
+  #error "RSBUS_BUS2_TCB is already used by another RS-bus"
+  #endif
+#endif
  
 // #define RSBUS_USES_SW_T3         // Pin ISR for pulse count, Timer instead of checkPolling()
 // #define RSBUS_USES_SW_T4         // Pin ISR for pulse count, Timer instead of checkPolling()
@@ -4,6 +4,11 @@
 // author:    Deisterholf / Aiko Pras
 // source:    https://github.com/deisterhold/Arduino-FIFO
 // history:   2019-01-30 V0.1 ap rewritten, to customize for the RS-bus purpose
+//            2026-10-14 V0.3 ag All FIFOs share a single pool of nibbles
+//                               Optional timestamp per element (RSBUS_LATENCY)
+//                               push() returns false if the pool is full
+//                               Pool admission based on priority and a fair share per FIFO
+//                               space(): the number of elements push() would still accept
 //
 // purpose:   FIFO functions to store RS-bus data
 //
@@ -37,29 +42,104 @@
 #include <Arduino.h>
 #include "sup_fifo.h"
 
+uint8_t FIFO::buffer[FIFO_POOL_SIZE];
+uint8_t FIFO::next[FIFO_POOL_SIZE];
+#if defined(RSBUS_LATENCY)
+uint16_t FIFO::stamp[FIFO_POOL_SIZE];
+#endif
+uint8_t FIFO::freeList = 0;
+uint8_t FIFO::poolUsed = 0;
+uint8_t FIFO::inUse = 0;
+uint8_t FIFO::activeFifos = 0;
+uint8_t FIFO::priorityMask = 0;
+uint8_t FIFO::levelFifos[8];
+
+
 FIFO::FIFO() {                     // This is the constructor
   head = 0;
   tail = 0;
   numElements = 0;
+  level = 0;
 }
 
 
-FIFO::~FIFO() {}                   // This is the destructor
+FIFO::~FIFO() {empty();}           // This is the destructor
 
 
 uint8_t FIFO::size() {return numElements;}
 
 
-void FIFO::push(uint8_t data) {
-  if(numElements == FIFO_SIZE) {return;}
-  else {
-    numElements++;                 // Increment size   
-    if(numElements > 1) {          // Only move the tail if there is more than one element
-      tail++;                      // Increment tail location     
-      tail %= FIFO_SIZE;           // Make sure tail is within the bounds of the array
-    }
-    buffer[tail] = data;           // Store data into array
+#if defined(RSBUS_LATENCY)
+uint16_t FIFO::stampOldest() {return (numElements) ? stamp[head - 1] : 0;}
+#endif
+
+
+bool FIFO::admits(uint8_t priority, uint8_t elements, uint8_t used, uint8_t active, uint8_t mask) {
+  // Pool admission (see sup_fifo.h), for a FIFO with "elements" elements, if "used" elements of the
+  // pool are in use by "active" FIFOs and "mask" holds the levels with data waiting. Only the levels
+  // above priority count for the reserve
+  uint8_t reserve = FIFO_RESERVE * __builtin_popcount(mask >> (priority + 1));
+  uint8_t available = FIFO_POOL_SIZE - used;
+  if (available <= reserve) {return false;} // Left for FIFOs with a higher priority
+  if ((available - reserve <= FIFO_RESERVE) && (elements) && (active > 1) &&
+    ((uint16_t) elements * active >= used)) {return false;} // Leave it for the other FIFOs
+  return true;
+}
+
+
+uint8_t FIFO::space(uint8_t priority) {
+  // The fair share depends on the number of elements this FIFO takes, thus add them one by one
+  priority &= 0x07;
+  uint8_t mask = priorityMask | (1 << priority); // As it would be after a push, the static is not touched
+  uint8_t count = 0;
+  uint8_t active = (numElements) ? activeFifos : activeFifos + 1;
+  while (admits(priority, numElements + count, inUse + count, active, mask)) count++;
+  return count;
+}
+
+
+void FIFO::joinLevel(uint8_t priority) {
+  level = priority;
+  levelFifos[level]++;
+  priorityMask |= (1 << level);    // Reserves elements for this level
+}
+
+
+void FIFO::leaveLevel(void) {
+  levelFifos[level]--;
+  if (levelFifos[level] == 0) priorityMask &= ~(1 << level); // Ends the reservation
+}
+
+
+bool FIFO::push(uint8_t data, uint8_t priority) {
+  uint8_t element;                 // Pool element + 1
+  priority &= 0x07;
+  if (!admits(priority, numElements, inUse, activeFifos, priorityMask)) {return false;}
+  if (freeList) {                  // Take an element from the free list
+    element = freeList;
+    freeList = next[element - 1];
+  }
+  else if (poolUsed < FIFO_POOL_SIZE) {element = ++poolUsed;} // Take a never used element
+  else {return false;}             // The pool is full
+  buffer[element - 1] = data;      // Store data into the pool
+  #if defined(RSBUS_LATENCY)
+  stamp[element - 1] = millis();
+  #endif
+  next[element - 1] = 0;           // The new element is the last one of this FIFO
+  if (numElements == 0) head = element;
+    else next[tail - 1] = element;
+  tail = element;
+  if (numElements == 0) {
+    activeFifos++;
+    joinLevel(priority);
   }
+  else if (priority != level) {    // The connection changed its priority
+    leaveLevel();
+    joinLevel(priority);
+  }
+  numElements++;                   // Increment size
+  inUse++;
+  return true;
 }
 
 
@@ -67,18 +147,23 @@ uint8_t FIFO::pop() {
   if(numElements == 0) {return 0;}
   else {
     numElements--;                 // Decrement size   
-    uint8_t data = buffer[head];   // Store the head of the queue in a temporary buffer
-    if(numElements >= 1) {
-      head++;                      // Move head up one position     
-      head %= FIFO_SIZE;           // Make sure head is within the bounds of the array
+    inUse--;
+    if (numElements == 0) {
+      activeFifos--;
+      leaveLevel();
     }
+    uint8_t element = head;
+    uint8_t data = buffer[element - 1]; // Store the head of the queue in a temporary buffer
+    head = next[element - 1];      // Move head to the next element
+    next[element - 1] = freeList;  // Return the element to the free list
+    freeList = element;
     return data;
   }
 }
 
 
 void FIFO::empty() {
+  while (numElements) pop();       // Return all elements to the free list
   head = 0;
   tail = 0;
-  numElements = 0;
 }
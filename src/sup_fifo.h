@@ -5,8 +5,29 @@
 // source:    https://github.com/deisterhold/Arduino-FIFO
 // history:   2019-01-30 V0.1 ap rewritten, to customize for the RS-bus purpose
 //            2021-11-29 V0.2 ap FIFO size increased, to facilitate retransmissions
+//            2026-10-14 V0.3 ag All FIFOs share a single pool of nibbles
+//                               Optional timestamp per element (RSBUS_LATENCY)
+//                               push() returns false if the pool is full
+//                               Pool admission based on priority and a fair share per FIFO
+//                               space(): the number of elements push() would still accept
 //
 // purpose:   FIFO functions to store RS-bus data
+//            Instead of a fixed buffer per FIFO (thus per RS-bus connection), all FIFOs take their
+//            elements from a single shared pool, with FIFO_POOL_SIZE elements. Each FIFO is therefore
+//            a linked list of pool elements. SRAM usage depends on the total number of nibbles waiting
+//            at the same time, and no longer on the number of RS-bus addresses used by the decoder.
+//            Only the main loop may access the FIFOs; the ISR doesn't.
+//            Since every RS-bus connection has its own transmit slot, connections don't compete for
+//            the ISR, but only for the pool. To ensure a chatty connection can't take all elements:
+//            - each priority level that has data waiting reserves FIFO_RESERVE elements for itself,
+//              that can not be taken by FIFOs of a lower priority. Once all FIFOs of that level are
+//              empty, the reservation ends.
+//            - once less than FIFO_RESERVE unreserved elements are left, a FIFO that holds at least
+//              the average number of elements of the non-empty FIFOs may no longer grow. The last
+//              elements are thereby left for the FIFOs that have less waiting. If no other FIFO has
+//              data waiting, a single FIFO may take all unreserved elements.
+//            As long as no priorities are used and the pool is not close to full, all FIFOs may
+//            take as many elements as needed.
 //            
 /*
  * FIFO Buffer
@@ -37,8 +58,18 @@
 //******************************************************************************************************
 #pragma once
 #include <Arduino.h>
+#include "RSbusVariants.h"
 
-#define FIFO_SIZE 32
+// Total number of elements that can be stored in all FIFOs together. Each element takes 2 bytes.
+// FIFO_SIZE is the maximum number of elements that can be stored in a single FIFO.
+#ifndef FIFO_POOL_SIZE
+#define FIFO_POOL_SIZE 32
+#endif
+#define FIFO_SIZE FIFO_POOL_SIZE
+// Elements reserved per priority level, and the margin before the fair share applies
+#ifndef FIFO_RESERVE
+#define FIFO_RESERVE 4
+#endif
 
 class FIFO {
 
@@ -46,14 +77,35 @@ public:
   FIFO();
   ~FIFO();
   void empty();
-  void push(uint8_t data);
+  bool push(uint8_t data, uint8_t priority = 0); // False if refused by the pool; the data is dropped
   uint8_t pop();
   uint8_t size();
+  uint8_t space(uint8_t priority = 0); // Number of elements push() would still accept
+  #if defined(RSBUS_LATENCY)
+  uint16_t stampOldest();          // millis() at the moment the oldest element was pushed
+  #endif
 
 private:
-  uint8_t head;
-  uint8_t tail;
+  uint8_t head;                    // Pool element + 1 of the oldest element. 0: FIFO is empty
+  uint8_t tail;                    // Pool element + 1 of the newest element
   uint8_t numElements;
-  uint8_t buffer[FIFO_SIZE];
-  
+  uint8_t level;                   // Priority level of the waiting elements (if numElements > 0)
+
+  // The shared pool. An element is either part of a FIFO, or part of the free list.
+  // next holds the element + 1 of the next element, thus 0 terminates a list.
+  // Elements from poolUsed onwards have never been used yet, and are free as well.
+  static uint8_t buffer[FIFO_POOL_SIZE];
+  static uint8_t next[FIFO_POOL_SIZE];
+  #if defined(RSBUS_LATENCY)
+  static uint16_t stamp[FIFO_POOL_SIZE];
+  #endif
+  static uint8_t freeList;
+  static uint8_t poolUsed;
+  static uint8_t inUse;            // Elements that are part of a FIFO
+  static uint8_t activeFifos;      // FIFOs with at least one element
+  static uint8_t priorityMask;     // Bit per priority level (0..7) that has data waiting
+  static uint8_t levelFifos[8];    // Per priority level the number of FIFOs with data waiting
+  void joinLevel(uint8_t priority);// This FIFO now has data waiting at priority
+  void leaveLevel(void);           // This FIFO no longer has data waiting at level
+  bool admits(uint8_t priority, uint8_t elements, uint8_t used, uint8_t active, uint8_t mask); // Pool admission
 };
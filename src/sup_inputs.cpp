@@ -0,0 +1,104 @@
+//************************************************************************************************
+//
+// file:      sup_inputs.cpp
+// purpose:   Support file for the RS-bus library.
+//            Optional scanner for the feedback inputs of the decoder. See sup_inputs.h
+// history:   2026-10-14 ag V1.0 Initial version
+//
+// This source file is subject of the GNU general public license 3,
+// that is available at the world-wide-web at http://www.gnu.org/licenses/gpl.txt
+//
+//************************************************************************************************
+#include <Arduino.h>
+#include "RSbus.h"
+#include "sup_inputs.h"
+
+
+RSbusInputs::RSbusInputs(void) {
+  sampleTime = 5;                              // 4 samples: the inputs must be stable for 20ms
+  bytes = 0;
+  sampled = false;
+  tLastSample = 0;
+}
+
+
+bool RSbusInputs::add(volatile uint8_t *reg, uint8_t activeLow, uint8_t used) {
+  if (bytes >= RSBUS_INPUT_BYTES) return false;
+  inputRegister[bytes] = reg;
+  invert[bytes] = activeLow;
+  mask[bytes] = used;
+  state[bytes] = 0;
+  count0[bytes] = 0xFF;                        // All counters in their reset state (3)
+  count1[bytes] = 0xFF;
+  connection[bytes] = 0;
+  bank[bytes] = 0;
+  bankIndex[bytes] = 0;
+  return true;
+}
+
+
+bool RSbusInputs::addByte(volatile uint8_t *reg, RSbusConnection &target, uint8_t activeLow, uint8_t used) {
+  if (!add(reg, activeLow, used)) return false;
+  connection[bytes] = &target;
+  bytes++;
+  return true;
+}
+
+
+bool RSbusInputs::addByte(volatile uint8_t *reg, RSbusBank &target, uint8_t index, uint8_t activeLow,
+  uint8_t used) {
+  if (!add(reg, activeLow, used)) return false;
+  bank[bytes] = &target;
+  bankIndex[bytes] = index;
+  bytes++;
+  return true;
+}
+
+
+uint8_t RSbusInputs::read(uint8_t index) {
+  return (index < bytes) ? state[index] : 0;
+}
+
+
+uint8_t RSbusInputs::sample(uint8_t index) {
+  return (*inputRegister[index] ^ invert[index]) & mask[index];
+}
+
+
+void RSbusInputs::deliver(uint8_t index) {
+  // send8bits() and write() only send the nibble(s) that changed
+  if (connection[index]) connection[index]->send8bits(state[index]);
+    else bank[index]->write(bankIndex[index], state[index]);
+}
+
+
+void RSbusInputs::check(void) {
+  // A connection that needs all its feedback bits gets the debounced state (even within a sample period)
+  for (uint8_t i = 0; i < bytes; i++) {
+    if (connection[i] && connection[i]->feedbackRequested && sampled) deliver(i);
+  }
+  if ((millis() - tLastSample) < sampleTime) return;
+  tLastSample = millis();
+  if (!sampled) {
+    // The first sample is the initial state. It isn't debounced, since it is not a change
+    for (uint8_t i = 0; i < bytes; i++) {
+      state[i] = sample(i);
+      deliver(i);
+    }
+    sampled = true;
+    return;
+  }
+  for (uint8_t i = 0; i < bytes; i++) {
+    // Vertical counters: per bit that equals the debounced state the counter is reset to 3, per
+    // bit that differs the counter decrements (2, 1, 0). The bits whose counter rolls over from 0
+    // to 3, thus after 4 consecutive samples that differ, toggle.
+    uint8_t delta = sample(i) ^ state[i];
+    count0[i] = ~(count0[i] & delta);
+    count1[i] = count0[i] ^ (count1[i] & delta);
+    uint8_t toggle = delta & count0[i] & count1[i];
+    if (toggle) {
+      state[i] ^= toggle;
+      deliver(i);
+    }
+  }
+}
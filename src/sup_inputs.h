@@ -0,0 +1,80 @@
+//************************************************************************************************
+//
+// file:      sup_inputs.h
+// purpose:   Support file for the RS-bus library.
+//            Optional scanner for the feedback inputs of the decoder. Reads complete input
+//            registers, debounces all bits in parallel and passes changes to the connections.
+// history:   2026-10-14 ag V1.0 Initial version
+//
+// This source file is subject of the GNU general public license 3,
+// that is available at the world-wide-web at http://www.gnu.org/licenses/gpl.txt
+//
+// Most feedback decoders read 8 inputs per RS-bus address, debounce these and call send8bits() once
+// an input changes. Instead of a digitalRead() per input, RSbusInputs reads per byte a complete input
+// register (such as PIND on traditional ATMega processors or PORTD.IN on MegaCoreX / DxCore
+// processors) with a single instruction. Each input byte is connected to a RSbusConnection, or to
+// an address of a RSbusBank.
+//
+// Debouncing uses vertical counters: per input bit a 2 bit counter, with the low order bits of all 8
+// counters stored in one byte (count0) and the high order bits in another (count1). All 8 counters
+// are thereby updated by a few logical operations. A counter is reset as long as the input equals its
+// debounced state; once the input has differed for 4 consecutive samples, the debounced state
+// toggles. With the default sampleTime of 5ms, an input must thus be stable during 20ms.
+//
+// Once the debounced state of a byte changes, send8bits() (or RSbusBank::write()) is called, which
+// only sends the nibble(s) that changed. If a connection requests its feedback bits after a
+// (re)synchronisation, check() answers with the debounced state, thus the main sketch doesn't
+// need to handle feedbackRequested either.
+//
+//************************************************************************************************
+#pragma once
+#include <Arduino.h>
+
+// Maximum number of input bytes (thus RS-bus addresses) per RSbusInputs object
+#ifndef RSBUS_INPUT_BYTES
+#define RSBUS_INPUT_BYTES 8
+#endif
+
+class RSbusConnection;
+class RSbusBank;
+
+
+class RSbusInputs {
+  public:
+    RSbusInputs(void);                  // The constructor
+
+    uint8_t sampleTime;                 // Time (ms) between two samples. Debounce time is 4 * sampleTime (default: 5)
+
+    bool addByte(                       // Adds an input byte. Returns false if all bytes are in use
+      volatile uint8_t *inputRegister,  // For example &PIND, or portInputRegister(digitalPinToPort(pin))
+      RSbusConnection &connection,      // The connection that sends these 8 feedback bits
+      uint8_t invert = 0xFF,            // Inputs that are active low. Default: all (inputs with pull-up)
+      uint8_t mask = 0xFF);             // Inputs that are used. The other feedback bits remain 0
+
+    bool addByte(                       // Same, but the bits are send via address bankIndex of a bank
+      volatile uint8_t *inputRegister,
+      RSbusBank &bank,
+      uint8_t bankIndex,
+      uint8_t invert = 0xFF,
+      uint8_t mask = 0xFF);
+
+    void check(void);                   // Samples and debounces the inputs. Call from main frequently
+    uint8_t read(uint8_t index);        // The debounced state of input byte index (in order of addByte())
+
+  private:
+    uint8_t bytes;                                     // Number of input bytes added
+    volatile uint8_t *inputRegister[RSBUS_INPUT_BYTES];// Per byte the input register
+    uint8_t invert[RSBUS_INPUT_BYTES];                 // Per byte the active low inputs
+    uint8_t mask[RSBUS_INPUT_BYTES];                   // Per byte the inputs in use
+    uint8_t state[RSBUS_INPUT_BYTES];                  // Per byte the debounced state
+    uint8_t count0[RSBUS_INPUT_BYTES];                 // Per byte bit 0 of the 8 vertical counters
+    uint8_t count1[RSBUS_INPUT_BYTES];                 // Per byte bit 1 of the 8 vertical counters
+    RSbusConnection *connection[RSBUS_INPUT_BYTES];    // Per byte the connection, or 0 if a bank is used
+    RSbusBank *bank[RSBUS_INPUT_BYTES];                // Per byte the bank, or 0 if a connection is used
+    uint8_t bankIndex[RSBUS_INPUT_BYTES];              // Per byte the address within the bank
+    bool sampled;                                      // The inputs have been sampled at least once
+    unsigned long tLastSample;                         // Time in ms of the previous sample
+    uint8_t sample(uint8_t index);                     // Reads the inputs of a byte
+    void deliver(uint8_t index);                       // Passes the debounced state to the connection
+    bool add(volatile uint8_t *inputRegister, uint8_t invert, uint8_t mask);
+};
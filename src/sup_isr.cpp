@@ -0,0 +1,125 @@
+//******************************************************************************************************
+//
+// file:      sup_isr.cpp
+// purpose:   Support file for the RS-bus library.
+//            Defines the administration of the transmit slots, which is shared by all ISR variants.
+// history:   2026-10-14 ag V1.0 Initial version: slot queues, timestamps for the latency histograms, slotRequeue()
+//
+// This source file is subject of the GNU general public license 3,
+// that is available at the world-wide-web at http://www.gnu.org/licenses/gpl.txt
+//
+// Each RSbusConnection object has its own transmit slot. At the start of each polling cycle (thus
+// during the period of silence) checkPolling() calls armSlots(), which puts all slots that have data
+// waiting into the schedule, sorted on their RS-bus address. The ISR only needs to know the address
+// of the first entry in this schedule (nextAddress). For the software based variants this means that
+// the cost per RS-bus pulse is a single compare, irrespective of the number of slots. For the RTC
+// and TCB based variants, nextAddress is the value that will be loaded into the compare register.
+// Once the ISR has served an entry, it calls nextSlot() to move to the next entry.
+//
+// The schedule is only modified by armSlots() during silence, and by nextSlot() from within the ISR.
+//
+// Each slot has a queue of RSBUS_SLOT_QUEUE bytes. queueHead and queueTail are free running counters;
+// the number of bytes waiting is their difference. Since queueTail is only written by the main loop
+// and queueHead only by the ISR, no locking is needed for the queue itself. data2sendMask however is
+// written by both, so the main loop modifies it with interrupts disabled. Note that the ISR only
+// clears the slot's bit if the queue became empty; if sendNibble() adds a byte at the same moment,
+// it sets the bit after queueTail was incremented, so the bit can't be lost.
+//
+//******************************************************************************************************
+#include <Arduino.h>
+#include "sup_isr.h"
+
+
+void RSbusIsr::armSlots(uint8_t mask, uint8_t distance) volatile {
+  // Step 1: insertion sort of all slots in mask, based on their address
+  uint8_t count = 0;
+  for (uint8_t slot = 0; slot < RSBUS_MAX_SLOTS; slot++) {
+    if (mask & (1 << slot)) {
+      uint8_t i = count;
+      while ((i > 0) && (address2use[schedule[i - 1]] > address2use[slot])) {
+        schedule[i] = schedule[i - 1];
+        i--;
+      }
+      schedule[i] = slot;
+      count++;
+    }
+  }
+  // Step 2: remove slots that are too close to the previous slot. These remain in data2sendMask,
+  // and will therefore be armed again during the next period of silence
+  uint8_t armed = 0;
+  uint8_t size = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t slot = schedule[i];
+    if ((size == 0) || (address2use[slot] >= address2use[schedule[size - 1]] + distance)) {
+      schedule[size] = slot;
+      armed |= (1 << slot);
+      size++;
+    }
+  }
+  scheduleSize = size;
+  scheduleIndex = 0;
+  if (size) nextAddress = address2use[schedule[0]];
+    else nextAddress = 0;
+  data4IsrMask = armed;                     // Tell the ISR which slots may be send
+}
+
+
+//******************************************************************************************************
+uint8_t RSbusIsr::slotCount(uint8_t slot) volatile {
+  return (uint8_t)(queueTail[slot] - queueHead[slot]);
+}
+
+
+void RSbusIsr::slotPush(uint8_t slot, uint8_t data, uint16_t stamp) volatile {
+  data2send[slot][queueTail[slot] & (RSBUS_SLOT_QUEUE - 1)] = data;
+  #if defined(RSBUS_LATENCY)
+  this->stamp[slot][queueTail[slot] & (RSBUS_SLOT_QUEUE - 1)] = stamp;
+  #endif
+  queueTail[slot]++;                        // Only now the ISR may take the byte
+  uint8_t oldSREG = SREG;                   // Restored, instead of enabling interrupts
+  noInterrupts();                           // The ISR may modify other bits of data2sendMask
+  data2sendMask |= (1 << slot);             // Tell checkPolling() / the ISR that data is waiting
+  SREG = oldSREG;
+}
+
+
+void RSbusIsr::slotFlush(uint8_t slot) volatile {
+  uint8_t oldSREG = SREG;                   // Restored, instead of enabling interrupts
+  noInterrupts();
+  queueHead[slot] = queueTail[slot];
+  data2sendMask &= ~(1 << slot);
+  data4IsrMask &= ~(1 << slot);
+  SREG = oldSREG;
+}
+
+
+bool RSbusIsr::slotRequeue(void) volatile {
+  // Called during the period of silence after a polling cycle with errors. The bytes that were
+  // send in that cycle are put in front of their queues again, and thus send again before newer
+  // bytes. Returns false, without modifying any queue, if one of the queues lacks space; a full
+  // retransmission is then needed. The producers never fill a queue beyond RSBUS_SLOT_QUEUE - 1
+  // bytes (sendNibble()) or 1 byte (coalesce, RSbusBank). A queue that holds RSBUS_SLOT_QUEUE - 1
+  // bytes has no push pending, and otherwise the pending push still fits after the requeue. Thus
+  // false is only returned if a queue is completely full, which these producers never cause.
+  bool result = true;
+  uint8_t oldSREG = SREG;                   // slotRequeue() may be called by a timer ISR, which
+  noInterrupts();                           // must not be interrupted by the RS-bus ISR
+  for (uint8_t slot = 0; slot < RSBUS_MAX_SLOTS; slot++) {
+    if ((sentLastCycle & (1 << slot)) && (slotCount(slot) >= RSBUS_SLOT_QUEUE)) result = false;
+  }
+  if (result) {
+    for (uint8_t slot = 0; slot < RSBUS_MAX_SLOTS; slot++) {
+      if (sentLastCycle & (1 << slot)) {
+        queueHead[slot]--;                  // The ISR is the only consumer, and is silent now
+        data2send[slot][queueHead[slot] & (RSBUS_SLOT_QUEUE - 1)] = lastSent[slot];
+        #if defined(RSBUS_LATENCY)
+        stamp[slot][queueHead[slot] & (RSBUS_SLOT_QUEUE - 1)] = millis();
+        #endif
+        data2sendMask |= (1 << slot);
+      }
+    }
+    sentLastCycle = 0;                      // Don't resend the same bytes twice
+  }
+  SREG = oldSREG;
+  return result;
+}
@@ -5,6 +5,14 @@
 // history:   2019-01-30 ap V0.1 Initial version
 //            2021-09-25 ap V1.0 Production version
 //            2022-07-27 ap V1.1 millis() replaced by micros()
+//            2026-10-14 ag V1.2 Transmit slots per RSbusConnection, instead of one shared slot
+//                               Armed slots are sorted, so the ISR needs a single compare per pulse
+//                               Each slot has a small queue, so the ISR can send back-to-back
+//                               Optional latency histograms (RSBUS_LATENCY), nibblesSent counter
+//                               The ISR remembers the bytes send, for selective retransmission
+//                               Noise rejection for sup_isr_sw_tcb.cpp
+//                               A single slot if RSBUS_FIXED_ADDRESS is defined
+//                               Nibbles that would be send too late are held for the next cycle
 //
 // This source file is subject of the GNU general public license 3,
 // that is available at the world-wide-web at http://www.gnu.org/licenses/gpl.txt
@@ -12,38 +20,135 @@
 //************************************************************************************************
 #pragma once
 #include <Arduino.h>
+#include "RSbusVariants.h"
 
 // declare the RS-bus Interrupt Service Routine. 
 void rs_interrupt(void);
 
 
+// Each RSbusConnection object gets its own transmit slot, which makes it possible that all
+// connections (RS-bus addresses) of this decoder send a nibble within the same polling cycle.
+// The slot administration uses a single bit per slot, so at most 8 slots can be supported.
+// With a fixed address (see RSbusVariants.h) there is a single connection, thus a single slot.
+#if defined(RSBUS_FIXED_ADDRESS)
+  #define RSBUS_MAX_SLOTS 1
+#else
+  #define RSBUS_MAX_SLOTS 8
+#endif
+
+// Each slot has a small single-producer / single-consumer queue. The main loop (sendNibble())
+// is the only producer and writes queueTail; the ISR is the only consumer and writes queueHead.
+// As long as the queue is not empty, the slot's bit in data2sendMask remains set, and the slot
+// is armed again during the next period of silence, without the main loop being involved.
+// The main loop keeps one place free, for the byte slotRequeue() may put back after an error.
+// RSBUS_SLOT_QUEUE must be a power of 2.
+#define RSBUS_SLOT_QUEUE 4
+
+// If RSBUS_LATENCY is defined, each nibble gets a timestamp (millis(), 16 bits) once it is handed
+// over by send4bits() / send8bits(). Once the ISR writes the nibble to the USART, it adds the time
+// that has passed to the slot's latency histogram. Bin 0 counts latencies below 16ms, bin 1 below
+// 32ms, bin 2 below 64ms etc., and the last bin all latencies of 1024ms or more. The counters stop
+// at 65535. Latencies above 65s can not be measured, due to the 16 bit timestamps.
+#define RSBUS_LATENCY_BINS 8
+
+
 // Define the RSbusIsr class
 class RSbusIsr {
   public:                                   // All attributes modified by the ISR => Volatile
-    volatile bool data2sendFlag;            // Flag set by main sketch that there is data to send
-    uint8_t data2send;                      // Actual data byte that will be send over the RS-bus
-    uint8_t address2use;                    // Address to use for the next message (data2send)
+    volatile uint8_t data2sendMask = 0;     // Bit per slot, set as long as the slot's queue is not empty
+    uint8_t data2send[RSBUS_MAX_SLOTS][RSBUS_SLOT_QUEUE]; // Per slot the data bytes waiting to be send
+    uint8_t queueHead[RSBUS_MAX_SLOTS] = {}; // Per slot the number of bytes taken by the ISR
+    uint8_t queueTail[RSBUS_MAX_SLOTS] = {}; // Per slot the number of bytes added by sendNibble()
+    uint8_t address2use[RSBUS_MAX_SLOTS] = {}; // Per slot the address to use for that data byte
+    #if defined(RSBUS_LATENCY)
+    uint16_t stamp[RSBUS_MAX_SLOTS][RSBUS_SLOT_QUEUE]; // Per slot the timestamps of the waiting bytes
+    uint16_t latency[RSBUS_MAX_SLOTS][RSBUS_LATENCY_BINS]; // Per slot the latency histogram
+    #endif
 
     // -------------------------------------------------------------------------------------------
     // The variables defined below are for internal use between checkPolling() and the ISR,
     // and must be defined as public to allow access by the ISR(s)
-    volatile bool data4IsrFlag;             // Flag set by checkPolling for the ISR that data is ready
-    volatile bool dataWasSendFlag;          // Flag between the ISR and CheckPolling
-    volatile bool flagPulseCount;           // Retransmit after a pulse count error?
-    volatile bool flagParity;               // Will we retransmit after a parity error?
+    volatile uint8_t data4IsrMask = 0;      // Bit per slot, set by checkPolling if data is ready for the ISR
+
+    // At the start of each polling cycle armSlots() sorts the slots that will be served by the ISR on
+    // their RS-bus address. The ISR therefore only needs to compare addressPolled against nextAddress,
+    // irrespective of the number of connections.
+    uint8_t schedule[RSBUS_MAX_SLOTS];      // The armed slots, in the order they will be served
+    uint8_t scheduleSize = 0;               // Number of slots in schedule
+    uint8_t scheduleIndex;                  // Entry in schedule that will be served next
+    uint8_t nextAddress = 0;                // Address belonging to that entry, 0 if none
+    volatile bool dataWasSendFlag = false;  // Flag between the ISR and CheckPolling
+    volatile bool flagPulseCount = false;   // Retransmit after a pulse count error?
+    volatile bool flagParity = false;       // Will we retransmit after a parity error?
 
     volatile uint8_t timeIdle;              // How long is the command station idle (volatile: reset by 4ms ISR)
     unsigned long tLastCheck;               // Time in microsec
-    uint16_t lastPulseCnt;                  // Previous value of the silence counter
+    uint16_t lastPulseCnt = 0;              // Previous value of the silence counter
+
+    uint32_t nibblesSent = 0;               // Telemetry: nibbles written to the USART (saturates)
+    uint32_t lateSkips = 0;                 // Telemetry: nibbles held, since the write was too late (saturates)
+
+    // For selective retransmission (parityErrorHandling / pulseCountErrorHandling = 3) the ISR keeps
+    // the last byte send per slot. At the start of a new polling cycle sentMask is copied to
+    // sentLastCycle; if that cycle turns out to have errors, slotRequeue() puts those bytes in front
+    // of their queues again.
+    uint8_t lastSent[RSBUS_MAX_SLOTS];      // Per slot the byte that was send last
+    uint8_t sentMask = 0;                   // Bit per slot that did send during the current cycle
+    uint8_t sentLastCycle = 0;              // Bit per slot that did send during the previous cycle
 
     // Specific for the software based ISRs (pulse count is performed in software within the ISR)
-    volatile uint8_t addressPolled;         // Address of RS-bus slave that is polled now
+    volatile uint8_t addressPolled = 0;     // Address of RS-bus slave that is polled now
   
-    // Specific for sup_isr_hw_tcb.cpp
-    uint8_t ccmpValue;                      // To reinitialise the CNT register of the Compare Match ISR
+    // Specific for sup_isr_sw_tcb.cpp
+    uint16_t minPeriodTicks;                // Pulses that follow sooner on the previous pulse are noise
+    uint16_t rejectedTicks;                 // Time between the previous valid pulse and rejected pulses
+    uint32_t pulsesRejected = 0;            // Telemetry: pulses ignored as noise (saturates)
+    uint16_t maxDelayTicks;                 // Writes that would start later after the pulse edge are held
+
+    // Specific for sup_isr_hw_tcb.cpp, sup_isr_hw_tca.cpp and sup_isr_hw_tx.cpp
+    uint8_t ccmpValue = 0;                  // To reinitialise the CNT register of the Compare Match ISR
 
     // Specific for sup_isr_sw_4ms.cpp
     unsigned long tLastInterrupt;           // Time in msec, used by checkPolling()
 
-    RSbusIsr(void);                         // Constructor: all attributes get default value 0
+    RSbusIsr(void);                         // Constructor: the variant specific part. The defaults are above
+
+    // Arms the slots in mask for the next polling cycle. A slot whose address is less than distance
+    // above the previous armed address will not be armed, but remains waiting for the next cycle.
+    void armSlots(uint8_t mask, uint8_t distance) volatile;
+    inline void nextSlot(void) volatile;    // Called by the ISR to move to the next entry in schedule
+
+    // The slot queues
+    uint8_t slotCount(uint8_t slot) volatile;           // Number of bytes waiting in the queue
+    void slotPush(uint8_t slot, uint8_t data, uint16_t stamp = 0) volatile; // Main: add a byte. Check slotCount() first!
+    inline uint8_t slotPop(uint8_t slot) volatile;      // ISR: take the oldest byte
+    void slotFlush(uint8_t slot) volatile;              // Main: drop all bytes waiting in the queue
+    bool slotRequeue(void) volatile;                    // Silence: resend the bytes of sentLastCycle
 };
+
+
+//************************************************************************************************
+// The following are called from within the ISRs. They are defined inline, since a call to a
+// function in another file forces the ISR to save and restore all call-used registers.
+void RSbusIsr::nextSlot(void) volatile {
+  scheduleIndex++;
+  if (scheduleIndex < scheduleSize) nextAddress = address2use[schedule[scheduleIndex]];
+    else nextAddress = 0;
+}
+
+
+uint8_t RSbusIsr::slotPop(uint8_t slot) volatile {
+  uint8_t data = data2send[slot][queueHead[slot] & (RSBUS_SLOT_QUEUE - 1)];
+  #if defined(RSBUS_LATENCY)
+  uint16_t delay = ((uint16_t)millis() - stamp[slot][queueHead[slot] & (RSBUS_SLOT_QUEUE - 1)]) >> 4;
+  uint8_t bin = 0;
+  while (delay && (bin < RSBUS_LATENCY_BINS - 1)) {delay >>= 1; bin++;}
+  if (latency[slot][bin] < 0xFFFF) latency[slot][bin]++;
+  #endif
+  queueHead[slot]++;
+  if (queueHead[slot] == queueTail[slot]) data2sendMask &= ~(1 << slot); // Queue is now empty
+  if (nibblesSent != 0xFFFFFFFF) nibblesSent++;
+  lastSent[slot] = data;                    // For a possible selective retransmission
+  sentMask |= (1 << slot);
+  return data;
+}
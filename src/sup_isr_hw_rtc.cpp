@@ -7,12 +7,16 @@
 //            Uses the Real Time Counter (RTC) of MegaCoreX and DxCore processors.
 // history:   2021-10-10 ap V1.0 initial version
 //            2022-07-27 ap V1.1 millis() replaced by micros()
+//            2026-10-14 ag V1.2 Transmit slots per RSbusConnection
+//                               The CMP ISR takes the next address from the sorted schedule
+//                               The ISR takes the data from the slot's queue
+//                               Nibbles that would be send too late are held for the next cycle
 //
 // This source file is subject of the GNU general public license 3,
 // that is available at the world-wide-web at http://www.gnu.org/licenses/gpl.txt
 //
-// If data is available for sending, the data should be entered  into the "data2send" variable and
-// the "data2sendFlag" should be set.
+// If data is available for sending, the data should be added to the slot's queue with slotPush(),
+// which also sets the slot's bit in "data2sendMask".
 // A counter (RTC.CNT) counts the number of RS-bus pulses and once the counter value matches the
 // compare (RTC.CMP) value, an interrupt is raised and the data will be send.
 //
@@ -69,6 +73,14 @@
 // become active in the next polling cycle. Since register changes take effect only after 2
 // RTC clock transistions, the addresses 1 and 2 will not be active in the next polling cycle,
 // but only in a subsequent polling cycle after the next polling cycle has been completed. 
+//
+// Multiple RS-Bus addresses
+// =========================
+// If the decoder uses multiple addresses (RSbusConnection objects), each connection has its own
+// transmit slot. After a slot has been served, the CMP match ISR moves RTC.CMP to the next address
+// in the schedule (see sup_isr.cpp) within the same polling cycle. For the same reason as above, that next
+// address should be at least 4 higher than the address just served; slots with an address that is
+// closer will be served in the next polling cycle.
 // 
 // RS-Bus input signal
 // ===================
@@ -121,18 +133,16 @@ extern volatile RSbusIsr rsISR;      // instantiated in "RS-bus.cpp"
 extern USART rsUSART;                // instantiated in "sup_usart.cpp" We only use init()
 
 
+// Number of RS-bus pulses it takes before a new RTC.CMP value becomes active
+#define CMP_DELAY 3
+
+
+
 //******************************************************************************************************
 // RSbusIsr: constructor
 //******************************************************************************************************
 RSbusIsr::RSbusIsr(void) {       // Define the constructor
   lastPulseCnt = RTC.CNT;        // RTC.CNT value
-  data4IsrFlag = false;          // ISR acts on data4IsrFlag, instead of data2sendFlag
-  address2use = 0;               // Initialise address to 0
-  data2send = 0;                 // Empty our send data byte
-  data2sendFlag = false;         // No, we don't have anything to send yet
-  dataWasSendFlag = false;       // No, we didn't send anything yet
-  flagParity = false;            // No, we don't need to retranmit after a parity error
-  flagPulseCount = false;        // No, we don't need to retranmit after a pulse count error
   tLastCheck = micros();         // Current time
 }
 
@@ -150,14 +160,13 @@ RSbusIsr::RSbusIsr(void) {       // Define the constructor
 // to stop the rs_interrupt service routine, for symmetry reasons we have decided for an "attach"
 // and "detach".
 
-RSbusHardware::RSbusHardware() {                     // Constructor
-  rsSignalIsOK = false;                              // No valid RS-bus signal detected yet
-  swapUsartPin = false;                              // We use the default USART TX pin
-  interruptModeRising = true;                        // Earlier hardware triggered on FALLING
-  parityErrors = 0;                                  // Counter for the number of 10,7ms gaps
-  pulseCountErrors = 0;                              // Number of times a cycli did not have 130 pulses
-  parityErrorHandling = 1;                           // Default: if we have just send data, retransmit!
-  pulseCountErrorHandling = 2;                       // Default: always retransmit all feedback data
+RSbusHardware::RSbusHardware(uint8_t busNumber) {    // Constructor
+  bus = busNumber;                                   // Always 0: this variant supports a single bus
+  isr = &rsISR;
+  clearTelemetry();                                  // Set all telemetry counters to 0
+  #if defined(RSBUS_STATISTICS)
+  clearStatistics();
+  #endif
 }
 
 
@@ -178,37 +187,21 @@ void RSbusHardware::attach(uint8_t usartNumber, uint8_t rxPin) {
   RTC.CLKSEL = RTC_CLKSEL_EXTCLK_gc;                 // Select EXTCLK as clock input
   RTC.CTRLA = RTC_RTCEN_bm;                          // Enable the RTC
   RTC.INTCTRL = RTC_CMP_bm | RTC_OVF_bm;             // Enable Compare Match and Overflow Interrupt    
+  #if defined(RSBUS_SILENCE_TIMER)
+  init_timerx();                                     // A timer calls resetAddressPolled() every 2ms
+  #endif
 }
 
 
 void RSbusHardware::detach(void) {
   RTC.CTRLA &= ~RTC_RTCEN_bm;                        // Disable the RTC
   RTC.INTCTRL = 0;
+  #if defined(RSBUS_SILENCE_TIMER)
+  stop_timerx();
+  #endif
 }
 
 
-//******************************************************************************************************
-void RSbusHardware::triggerRetransmission(uint8_t strategy, bool justTransmitted) {
-  // Retransmissions can be triggered by clearing the rsSignalIsOK flag.
-  // If this flag is cleared, checkConnection() sets the status to 'notSynchronised'
-  // empties the FIFO and clears the data2SendFlag.
-  // This will trigger the main sketch to retransmit (all 8 bits of) feedback data
-  switch (strategy) {
-    case 0:                                  // Do nothing
-    break;
-    case 1:                                  // Signal an error if we just transmitted
-      if (justTransmitted) rsSignalIsOK = false;
-    break;
-    case 2:                                  // Always signal an error
-      rsSignalIsOK = false;                  // Will trigger a retransmission
-    break;
-    default:                                 // Ignore
-    break;
-  }
-  // If the application will retransmit, we can cancel data ready for transmission
-  if (rsSignalIsOK == false) rsISR.data4IsrFlag = false;
-}
-
 //******************************************************************************************************
 // checkPolling(): Called from main as frequent as possible
 //******************************************************************************************************
@@ -223,57 +216,86 @@ void RSbusHardware::triggerRetransmission(uint8_t strategy, bool justTransmitted
 // - check 6: same as check 5 
 // - check 7: 12ms of silence: seems we lost the RS-signal
 void RSbusHardware::checkPolling(void) {
+  RSBUS_STATS_START
+  #if !defined(RSBUS_SILENCE_TIMER)
+  // Skip the following code, since a timer calls resetAddressPolled() every 2ms
   unsigned long currentTime = micros();                // will not chance during sub routine
   if ((currentTime - rsISR.tLastCheck) >= 2000) {      // Check once every 2 ms
-    rsISR.tLastCheck = currentTime;   
-    uint16_t currentCnt = RTC.CNT;                     // will not chance during sub routine
-    if (currentCnt == rsISR.lastPulseCnt) {            // This may be a silence period
-      rsISR.timeIdle++;                                // Counts which 2ms check we are in
-      switch (rsISR.timeIdle) {                        // See figures above
-      case 1:                                          // RTC.CNT differs from previous count
-      case 2:                                          // May also occur if UART send byte 
-      case 4:                                          // Same as case 3, nothing new
-      case 6:                                          // Same as case 5, nothing new
-      break;
-      case 3:                                          // Third check => SILENCE!
-        // Set flags for possible retransmission
-        rsISR.flagPulseCount = rsISR.dataWasSendFlag;  // ISR may set the dataWasSendFlag
-        rsISR.flagParity     = rsISR.dataWasSendFlag;  // and flags may trigger retransmission
-        rsISR.dataWasSendFlag = false;                 // but only is previous cycle had errors
-        if (currentCnt == 0) {                         // Figure: case 1A)
-          rsSignalIsOK = true;
-          if (rsISR.data2sendFlag) {
-            if (RTC.CMP == rsISR.address2use) rsISR.data4IsrFlag = true;
-          }
-        }
-        else {                                         // RTC Overflow out of sync
-          RTC.CNT = 3;                                 // RTC register updates takes 2 cycles
-          if (rsSignalIsOK) {                          // Do nothing during initialisation
-            pulseCountErrors ++;
-            triggerRetransmission(pulseCountErrorHandling, rsISR.flagPulseCount);
-          }
+    rsISR.tLastCheck = currentTime;
+    resetAddressPolled();
+  }
+  #endif
+  checkEvents();                                       // Callbacks and serviceConnections
+  RSBUS_STATS_STOP(checkPolling)
+}
+
+
+void RSbusHardware::resetAddressPolled(void) {
+  RSBUS_STATS_START
+  uint16_t currentCnt = RTC.CNT;                       // will not chance during sub routine
+  if (currentCnt == rsISR.lastPulseCnt) {              // This may be a silence period
+    rsISR.timeIdle++;                                  // Counts which 2ms check we are in
+    switch (rsISR.timeIdle) {                          // See figures above
+    case 1:                                            // RTC.CNT differs from previous count
+    case 2:                                            // May also occur if UART send byte 
+    case 4:                                            // Same as case 3, nothing new
+    case 6:                                            // Same as case 5, nothing new
+    break;
+    case 3:                                            // Third check => SILENCE!
+      // Set flags for possible retransmission
+      rsISR.flagPulseCount = rsISR.dataWasSendFlag;    // ISR may set the dataWasSendFlag
+      rsISR.flagParity     = rsISR.dataWasSendFlag;    // and flags may trigger retransmission
+      rsISR.dataWasSendFlag = false;                   // but only is previous cycle had errors
+      rsISR.sentLastCycle = rsISR.sentMask;            // The bytes that selective retransmission
+      rsISR.sentMask = 0;                              // may send again
+      if (currentCnt == 0) {                           // Figure: case 1A)
+        rsSignalIsOK = true;
+        cycleStarted(true);
+        rsISR.armSlots(rsISR.data2sendMask, CMP_DELAY + 1);
+        uint8_t first = rsISR.nextAddress;
+        if ((first) && (RTC.CMP != first)) {           // At least one slot has data waiting
+          RTC.CMP = first;                             // Addresses 1 and 2 become active next cycle
+          if (first < CMP_DELAY) rsISR.data4IsrMask = 0;
         }
-      break;
-      case 5:                                          // 8ms of silence
-        if (rsSignalIsOK) {                            // Only act if everything was OK before
-          parityErrors++;                              // Keep track of number of parity errors
-          triggerRetransmission(parityErrorHandling, rsISR.flagParity);
+      }
+      else {                                           // RTC Overflow out of sync
+        RTC.CNT = 3;                                   // RTC register updates takes 2 cycles
+        cycleStarted(false);                           // Telemetry: the previous cycle was not valid
+        if (rsSignalIsOK) {                            // Do nothing during initialisation
+          pulseCountErrors ++;
+          countError(telemetry.pulseCountErrors);
+          triggerRetransmission(pulseCountErrorHandling, rsISR.flagPulseCount);
         }
-      break;
-      case 7:                                          // 12ms of silence
-        if (rsSignalIsOK) parityErrors--;              // Wasn't a parity error
-        rsSignalIsOK = false;                          // But worse: a RS-bus signal loss
-        rsISR.data4IsrFlag = false;                    // Cancel possible data waiting for ISR
-      break;
-      default:                                         // Silence >= 14ms
-      break;
-      };
-    }
-    else {                                             // Not a silence period
-      rsISR.lastPulseCnt = currentCnt;                 // CNT can have any value <= 129 (=OVF)
-      rsISR.timeIdle = 1;                              // Reset silence (idle) period counter
+      }
+    break;
+    case 5:                                            // 8ms of silence
+      if (rsSignalIsOK) {                              // Only act if everything was OK before
+        parityErrors++;                                // Keep track of number of parity errors
+        parityPending = true;                          // Telemetry: counted once the silence ends
+        triggerRetransmission(parityErrorHandling, rsISR.flagParity);
+      }
+    break;
+    case 7:                                            // 12ms of silence
+      if (parityPending) parityErrors--;               // Wasn't a parity error
+      if (rsSignalIsOK || parityPending) rsCount(telemetry.signalLosses);
+      parityPending = false;                           // Not a parity error after all
+      cycleValid = false;                              // The next cycle doesn't follow a valid cycle
+      rsSignalIsOK = false;                            // But worse: a RS-bus signal loss
+      rsISR.data4IsrMask = 0;                          // Cancel possible data waiting for ISR
+    break;
+    default:                                           // Silence >= 14ms
+    break;
+    };
+  }
+  else {                                               // Not a silence period
+    rsISR.lastPulseCnt = currentCnt;                   // CNT can have any value <= 129 (=OVF)
+    rsISR.timeIdle = 1;                                // Reset silence (idle) period counter
+    if (parityPending) {                               // The silence was 8..12ms: parity error
+      parityPending = false;
+      countError(telemetry.parityErrors);
     }
   }
+  RSBUS_STATS_STOP(resetAddressPolled)
 }
 
 
@@ -281,23 +303,40 @@ void RSbusHardware::checkPolling(void) {
 // Define the RTC-based Interrupt Service routines (ISR) for the RS-bus
 //******************************************************************************************************
 ISR(RTC_CNT_vect) {
+  RSBUS_STATS_START
   // Do we have an Compare Match or an Overflow Interrupt?
   if (RTC.INTFLAGS == RTC_CMP_bm) {        // Compare Match
     RTC.INTFLAGS |= RTC_CMP_bm;            // Clear Compare Match interrupt
-    if (rsISR.data4IsrFlag) {
-      // We have data to send, it is our turn and the RSbus signal is valid
-      // Note: general USART code often includes some kind of flow control, but that is not needed here
-      *rsUSART.dataRegister = rsISR.data2send;
-      rsISR.data2sendFlag = false;         // RSbusConnection::sendNibble may now prepare new data
-      rsISR.data4IsrFlag = false;          // CheckPolling may reset the flag, is there is data2send
-      rsISR.dataWasSendFlag = true;        // used to trigger retransmission after arrors
+    if ((rsISR.scheduleIndex < rsISR.scheduleSize) && (RTC.CMP == rsISR.nextAddress)) {
+      uint8_t slot = rsISR.schedule[rsISR.scheduleIndex];
+      uint8_t slotBit = (1 << slot);
+      if (rsISR.data4IsrMask & slotBit) {
+        // We have data to send, it is our turn and the RSbus signal is valid
+        // Note: general USART code often includes some kind of flow control, but that is not needed here
+        // The compare interrupt is raised at the first count after RTC.CNT equals RTC.CMP, thus an ISR
+        // that runs in time sees RTC.CNT == RTC.CMP + 1. If RTC.CNT is higher, the next pulse was counted
+        // before this ISR started: our slot has passed and the nibble is kept for the next cycle. Due to
+        // the synchronisation between the clock domains (see CMP_DELAY), the RTC.CNT value read may lag
+        // behind, but never runs ahead. The check may therefore miss a late ISR, but never holds a
+        // nibble that could still be send.
+        if (RTC.CNT <= RTC.CMP + 1) {
+          *rsUSART.dataRegister = rsISR.slotPop(slot); // Clears the slot bit if the queue is empty
+          rsISR.dataWasSendFlag = true;    // used to trigger retransmission after arrors
+        }
+        else if (rsISR.lateSkips != 0xFFFFFFFF) rsISR.lateSkips++; // Keep the nibble for the next cycle
+        rsISR.data4IsrMask &= ~slotBit;    // CheckPolling may set the bit again, if there is data2send
+      }
+      rsISR.nextSlot();
+      // Modify, if the next data byte must be send from a different RS-bus address. Preferably
+      // still within this polling cycle, otherwise the first address of this cycle is kept for the next
+      if (rsISR.nextAddress) RTC.CMP = rsISR.nextAddress;
+        else RTC.CMP = rsISR.address2use[rsISR.schedule[0]];
     }
-    // Modify, if the next data byte must be send from a different RS-bus address
-    if (RTC.CMP != rsISR.address2use) RTC.CMP = rsISR.address2use;
   }
   else {                                   // Must be an overflow (
     RTC.INTFLAGS |= RTC_OVF_bm;            // Clear Overflow interrupt
   }
+  RSBUS_STATS_STOP(isr)
 }
 
 #endif // #if defined(RSBUS_USES_RTC)
@@ -0,0 +1,331 @@
+//******************************************************************************************************
+//
+// file:      sup_isr_hw_tca.cpp
+// purpose:   Support file for the RS-bus library.
+//            Defines the Interrupt Service routine (ISR) that counts the polling pulses transmitted by
+//            the master. Once this decoder is polled, the ISR can send data back via its USART.
+//            Uses TCA0 as event counter to count the pulses transmitted by the master.
+//            Runs on MegaCoreX (such as the 4808 and 4809) as well as DxCore processors, and as opposed
+//            to RSBUS_USES_RTC, the RS-bus input pin can be freely selected.
+// history:   2026-10-14 ag V1.0 initial version
+//
+// This source file is subject of the GNU general public license 3,
+// that is available at the world-wide-web at http://www.gnu.org/licenses/gpl.txt
+//
+// If data is available for sending, the data should be added to the slot's queue with slotPush(),
+// which also sets the slot's bit in "data2sendMask".
+// TCA0 counts the number of RS-bus pulses and once the counter value (TCA0.SINGLE.CNT) matches the
+// compare value (TCA0.SINGLE.CMP0), an interrupt is raised and the data will be send.
+//
+// TCA as Event User - Introduction
+// ================================
+// The RTC variant counts RS-bus pulses with very little CPU load, but requires the RS-bus input on
+// the EXTCLK pin (PA0). The HW_TCBx variant allows other pins, but requires the TCB "count on event"
+// mode, which MegaCoreX processors lack. On all MegaCoreX and DxCore processors however, the 16 bit
+// Timer/Counter type A (TCA0) can count events instead of clock ticks. Since the events are routed
+// via the Event System, every pin that can act as event generator can be used as RS-bus input.
+//
+// TCA as Event User - Count on positive edge
+// ------------------------------------------
+// If the Count Event Input Enable bit (CNTEI on MegaCoreX, CNTAEI on DxCore) in TCA0.SINGLE.EVCTRL
+// is set, and the Event Action is "count on positive edge", the counter is incremented by each
+// incoming event, instead of by the prescaled peripheral clock. The event needs to last for at least
+// one CLK_PER cycle to be recognized. TCA is synchronous to CLK_PER, thus register changes take effect
+// immediately; there is no latency like in the RTC clock domain.
+//
+// TCA - Normal mode and Compare Match
+// -----------------------------------
+// TCA0 is used in Normal mode with TCA0.SINGLE.PER = 0xFFFF, thus the counter never overflows during
+// a polling cycle. It generates the compare interrupt when the counter reaches TCA0.SINGLE.CMP0.
+// The master polls address A with pulse A+1, thus CMP0 is loaded with the address + 1.
+// As opposed to a TCB in Periodic Interrupt Mode, the compare match doesn't clear the counter,
+// thus the ISR doesn't need to revert the counter, and after a complete pulse train (thus at the
+// start of the silence period) the counter value is 130.
+//
+// TCA initialisation
+// ------------------
+// The counter will be reset by CheckPolling() during the silence period. This ensures that the
+// counter value is zero when the next pulse train starts.
+// Initialisation is also needed after start-up or after the RS-bus signal was lost and reappears.
+// To determine if initialisation is needed, checks are performed during the silence period
+// if the counter value matches 130. If this is not the case, a new initialisation takes place.
+// If the decoder uses multiple addresses (RSbusConnection objects), each connection has its own
+// transmit slot. CheckPolling() loads TCA0.SINGLE.CMP0 for the lowest address that has data waiting,
+// and after that slot has been served the ISR loads the next address from the schedule (see sup_isr.cpp).
+// Since TCA has no clock domain latency, the next address may directly follow the address just served.
+//
+// Note that CNT and CMP0 are 16 bit registers, which share the TEMP register. Since the ISR accesses
+// these registers as well, the main loop reads and writes them with interrupts disabled.
+//
+// TCA0 and the Arduino core
+// =========================
+// MegaCoreX and DxCore configure TCA0 in split mode, to provide PWM for analogWrite(). Once attach()
+// has been called, TCA0 is reset to single mode and analogWrite() on the TCA0 pins no longer works.
+// Make sure millis() / micros() don't use TCA0 (the default for both cores is a TCB).
+//
+// RS-Bus input pin
+// ================
+// The RS-Bus can be connected to any input pin that is available to the Event system.
+// The Event system triggers on positive edges, although the edge could be inverted via
+// the port pin control register after adding some code for that.
+//
+// Parity errors
+// =============
+// If the master station detects a parity error, it will enlarge the silence period
+//
+// Pins:
+// =====
+// - a RS-Bus input pin
+// - a transmit pin for the UART
+//
+//******************************************************************************************************
+#include <Arduino.h>
+#include "RSbus.h"
+#include "sup_isr.h"
+#include "sup_usart.h"
+
+// This code will only be used if we define in RSbusVariants.h the "RSBUS_USES_HW_TCA0" directive
+#if defined(RSBUS_USES_HW_TCA0)
+#include <Event.h>
+
+//******************************************************************************************************
+// The following objects are instantiated elsewhere, but are used here
+extern RSbusHardware rsbusHardware;  // instantiated in "RS-bus.cpp"
+extern volatile RSbusIsr rsISR;      // instantiated in "RS-bus.cpp"
+extern USART rsUSART;                // instantiated in "sup_usart.cpp" We only use init()
+
+
+//******************************************************************************************************
+// RSbusIsr: constructor
+//******************************************************************************************************
+RSbusIsr::RSbusIsr(void) {       // Define the constructor
+  tLastCheck = micros();         // Current time
+}
+
+
+//******************************************************************************************************
+//******************************************************************************************************
+// The RSbusHardware class is responsible for controlling the RS-bus hardware, thus the TCA that counts
+// the polling pulses send by the master, and the USART connected to an output pin to send messages
+// to the master.
+// Messages are: 8 bit, no parity, 1 stop bit, asynchronous mode, 4800 baud.
+// The "attach" method initialises the TCA and USART.
+// A detach method is available to disable the TCA, which is needed before a decoder gets restarted.
+// Note regarding the code: instead of the "RSbusHardware::attach" method we could have directly used
+// the RSbusIsr and USART class constructors. However, since we also need a "RSbusHardware::detach" method
+// to stop the rs_interrupt service routine, for symmetry reasons we have decided for an "attach"
+// and "detach".
+
+void RSbusHardware::initEventSystem(uint8_t rxPin) {
+  noInterrupts();
+  // Assign Event generator: RS-bus input clocks the timer
+  Event& myEvent = Event::assign_generator_pin(rxPin);
+  // Set Event User. The naming differs between the MegaCoreX and DxCore event libraries
+  #if defined(TCA_SINGLE_CNTAEI_bm)
+    myEvent.set_user(user::tca0_cnt_a);
+  #else
+    myEvent.set_user(user::tca0);
+  #endif
+  // Start the event channel
+  myEvent.start();
+  interrupts();
+}
+
+
+RSbusHardware::RSbusHardware(uint8_t busNumber) {    // Constructor
+  bus = busNumber;                                   // Always 0: this variant supports a single bus
+  isr = &rsISR;
+  clearTelemetry();                                  // Set all telemetry counters to 0
+  #if defined(RSBUS_STATISTICS)
+  clearStatistics();
+  #endif
+}
+
+
+void RSbusHardware::attach(uint8_t usartNumber, uint8_t rxPin) {
+  // In principle we could have implemented the 'interruptModeRising' parameter if we include
+  // something like PORT*.PIN*CTRL |= PORT_INVEN_bm
+  rxPinUsed = rxPin;                                 // Store, to allow a detach later
+  // Step 1: Initialise the RS bus transmission hardware (USART)
+  rsUSART.init(usartNumber, !swapUsartPin);
+  // Step 2: Initialise TCA0 in Normal mode, counting events
+  // Reset the timer, needed since the Arduino core uses TCA0 in split mode for PWM
+  noInterrupts();
+  TCA0.SINGLE.CTRLA = 0;                             // The timer must be disabled before a reset
+  TCA0.SINGLE.CTRLESET = TCA_SINGLE_CMD_RESET_gc;    // All registers to their initial values
+  TCA0.SINGLE.CTRLD = 0;                             // Single (16 bit) mode
+  // Initialise the control registers
+  TCA0.SINGLE.CTRLB = TCA_SINGLE_WGMODE_NORMAL_gc;   // Normal mode, no waveform outputs
+  TCA0.SINGLE.PER = 0xFFFF;                          // No overflow within a polling cycle
+  TCA0.SINGLE.CNT = 0;
+  TCA0.SINGLE.CMP0 = rsISR.ccmpValue + 1;            // Initial RS-Bus address
+  #if defined(TCA_SINGLE_CNTAEI_bm)                  // DxCore: event input A
+  TCA0.SINGLE.EVCTRL = TCA_SINGLE_CNTAEI_bm | TCA_SINGLE_EVACTA_CNT_POSEDGE_gc;
+  #else                                              // MegaCoreX
+  TCA0.SINGLE.EVCTRL = TCA_SINGLE_CNTEI_bm | TCA_SINGLE_EVACT_POSEDGE_gc;
+  #endif
+  TCA0.SINGLE.INTFLAGS = TCA_SINGLE_CMP0_bm;         // Clear a possible old Compare Match
+  TCA0.SINGLE.INTCTRL = TCA_SINGLE_CMP0_bm;          // Enable Compare Match 0 interrupts
+  TCA0.SINGLE.CTRLA = TCA_SINGLE_ENABLE_bm;          // Enable TCA, which now counts events
+  interrupts();
+  // Step 3: Route the RS-bus input pin to TCA0
+  initEventSystem(rxPin);
+  #if defined(RSBUS_SILENCE_TIMER)
+  init_timerx();                                     // A timer calls resetAddressPolled() every 2ms
+  #endif
+}
+
+
+void RSbusHardware::detach(void) {
+  noInterrupts();
+  // Clear all TCA timer settings
+  // For "reboot" (jmp 0) it is crucial to set INTCTRL = 0
+  TCA0.SINGLE.CTRLA = 0;
+  TCA0.SINGLE.EVCTRL = 0;
+  TCA0.SINGLE.INTCTRL = 0;
+  TCA0.SINGLE.CNT = 0;
+  TCA0.SINGLE.INTFLAGS = TCA_SINGLE_CMP0_bm;
+  interrupts();
+  #if defined(RSBUS_SILENCE_TIMER)
+  stop_timerx();
+  #endif
+}
+
+
+//******************************************************************************************************
+// checkPolling(): Called from main as frequent as possible
+//******************************************************************************************************
+// See for details: ../extras/BasicOperation-CheckPolling.md
+// CheckPolling() ignores all checks, except check 3 and check 5
+// - check 1: ignore
+// - check 2: ignore
+// - check 3: TCA0.SINGLE.CNT should be 130 => reinitialise values, including RS-bus address and flags
+// - check 4: ignore
+// - check 5: only happens after more than 8ms of silence: parity error (or signal loss)
+// - check 6: ignore
+// - check 7: 12ms of silence: seems we lost the RS-signal
+void RSbusHardware::checkPolling(void) {
+  RSBUS_STATS_START
+  #if !defined(RSBUS_SILENCE_TIMER)
+  // Skip the following code, since a timer calls resetAddressPolled() every 2ms
+  unsigned long currentTime = micros();                // will not chance during sub routine
+  if ((currentTime - rsISR.tLastCheck) >= 2000) {      // Check once every 2 ms
+    rsISR.tLastCheck = currentTime;
+    resetAddressPolled();
+  }
+  #endif
+  checkEvents();                                       // Callbacks and serviceConnections
+  RSBUS_STATS_STOP(checkPolling)
+}
+
+
+void RSbusHardware::resetAddressPolled(void) {
+  RSBUS_STATS_START
+  uint8_t oldSREG = SREG;                              // Restored, since we may run within a timer ISR
+  noInterrupts();                                      // The ISR also uses the TEMP register
+  uint16_t currentCnt = TCA0.SINGLE.CNT;               // will not chance during sub routine
+  SREG = oldSREG;
+  if (currentCnt == rsISR.lastPulseCnt) {              // This may be a silence period
+    rsISR.timeIdle++;                                  // Counts which 2ms check we are in
+    switch (rsISR.timeIdle) {                          // See figures above
+    case 1:                                            // TCA0.CNT differs from previous count
+    case 2:                                            // May also occur if UART send byte
+    case 4:                                            // Same as case 3, nothing new
+    case 6:                                            // Same as case 5, nothing new
+    break;
+    case 3:                                            // Third check => SILENCE!
+      rsISR.flagPulseCount = rsISR.dataWasSendFlag;    // ISR may set the dataWasSendFlag
+      rsISR.flagParity     = rsISR.dataWasSendFlag;    // and flags may trigger retransmission
+      rsISR.dataWasSendFlag = false;                   // but only is previous cycle had errors
+      rsISR.sentLastCycle = rsISR.sentMask;            // The bytes that selective retransmission
+      rsISR.sentMask = 0;                              // may send again
+      if (currentCnt == 130) {
+        rsSignalIsOK = true;
+        cycleStarted(true);
+        rsISR.armSlots(rsISR.data2sendMask, 1);        // Tell the ISR that data may be send
+        noInterrupts();
+        TCA0.SINGLE.CNT = 0;                           // Start a new polling cycle
+        if (rsISR.nextAddress) {                       // At least one slot has data waiting
+          TCA0.SINGLE.CMP0 = rsISR.nextAddress + 1;    // The RS-bus address may be changed
+          rsISR.ccmpValue = rsISR.nextAddress;         // For the ISR to compare against the schedule
+        }
+        SREG = oldSREG;
+        rsISR.lastPulseCnt = 0;                        // Update as well, since we still have silence
+      }
+      else {
+        noInterrupts();
+        TCA0.SINGLE.CNT = 0;                           // Start a new polling cycle
+        SREG = oldSREG;
+        rsISR.lastPulseCnt = 0;                        // Update as well, since we still have silence
+        cycleStarted(false);                           // Telemetry: the previous cycle was not valid
+        if (rsSignalIsOK) {                            // Do nothing during initialisation
+          pulseCountErrors ++;
+          countError(telemetry.pulseCountErrors);
+          triggerRetransmission(pulseCountErrorHandling, rsISR.flagPulseCount);
+        }
+      }
+    break;
+    case 5:                                            // 8ms of silence
+      if (rsSignalIsOK) {                              // Only act if everything was OK before
+        parityErrors++;                                // Keep track of number of parity errors
+        parityPending = true;                          // Telemetry: counted once the silence ends
+        triggerRetransmission(parityErrorHandling, rsISR.flagParity);
+      }
+    break;
+    case 7:                                            // 12ms of silence
+      if (parityPending) parityErrors--;               // Wasn't a parity error
+      if (rsSignalIsOK || parityPending) rsCount(telemetry.signalLosses);
+      parityPending = false;                           // Not a parity error after all
+      cycleValid = false;                              // The next cycle doesn't follow a valid cycle
+      rsSignalIsOK = false;                            // But worse: a RS-bus signal loss
+      rsISR.data4IsrMask = 0;                          // Cancel possible data waiting for ISR
+    break;
+    default:                                           // Silence >= 14ms
+    break;
+    };
+  }
+  else {                                               // Not a silence period
+    rsISR.lastPulseCnt = currentCnt;                   // CNT can have any value <= 130
+    rsISR.timeIdle = 1;                                // Reset silence (idle) period counter
+    if (parityPending) {                               // The silence was 8..12ms: parity error
+      parityPending = false;
+      countError(telemetry.parityErrors);
+    }
+  }
+  RSBUS_STATS_STOP(resetAddressPolled)
+}
+
+
+//******************************************************************************************************
+// Define the TCA-based Interrupt Service routine (ISR) for the RS-bus
+//******************************************************************************************************
+ISR(TCA0_CMP0_vect) {
+  RSBUS_STATS_START
+  // Note: the compare match doesn't clear the pulse counter. If the ISR started late (for example since
+  // other interrupts were being served), the next pulse(s) have already been counted. In that case the
+  // slot of our address has passed, and sending now would corrupt the byte of the next slave.
+  TCA0.SINGLE.INTFLAGS = TCA_SINGLE_CMP0_bm;   // We had an interrupt. Clear!
+  if ((rsISR.scheduleIndex < rsISR.scheduleSize) && (rsISR.ccmpValue == rsISR.nextAddress)) {
+    uint8_t slot = rsISR.schedule[rsISR.scheduleIndex];
+    uint8_t slotBit = (1 << slot);
+    if (rsISR.data4IsrMask & slotBit) {
+      // We have data to send, it is our turn and the decoder is synchronised
+      // Note: general USART code often includes some kind of flow control, but that is not needed here
+      if (TCA0.SINGLE.CNT == rsISR.ccmpValue + 1) {
+        *rsUSART.dataRegister = rsISR.slotPop(slot); // Clears the slot bit if the queue is empty
+        rsISR.dataWasSendFlag = true;      // used to trigger retransmission after arrors
+      }
+      else if (rsISR.lateSkips != 0xFFFFFFFF) rsISR.lateSkips++; // Keep the nibble for the next cycle
+      rsISR.data4IsrMask &= ~slotBit;      // CheckPolling may now select a new RS-bus address
+    }
+    // Load the next RS-bus address that has data waiting within this polling cycle
+    rsISR.nextSlot();
+    if (rsISR.nextAddress) {
+      TCA0.SINGLE.CMP0 = rsISR.nextAddress + 1;
+      rsISR.ccmpValue = rsISR.nextAddress;
+    }
+  }
+  RSBUS_STATS_STOP(isr)
+}
+
+#endif // #if defined(RSBUS_USES_HW_TCA0)
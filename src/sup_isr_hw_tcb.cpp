@@ -9,12 +9,16 @@
 //            MegaCoreX (such as the Nano Every) or traditional ATmega processors (such as the UNO).
 // history:   2021-10-16 ap V1.0 initial version
 //            2022-07-27 ap V1.2 millis() replaced by micros()
+//            2026-10-14 ag V1.3 Transmit slots per RSbusConnection
+//                               The ISR takes the next address from the sorted schedule
+//                               The ISR takes the data from the slot's queue
+//                               Nibbles that would be send too late are held for the next cycle
 //
 // This source file is subject of the GNU general public license 3,
 // that is available at the world-wide-web at http://www.gnu.org/licenses/gpl.txt
 //
-// If data is available for sending, the data should be entered  into the "data2send" variable and
-// the "data2sendFlag" should be set.
+// If data is available for sending, the data should be added to the slot's queue with slotPush(),
+// which also sets the slot's bit in "data2sendMask".
 // TCBx counts the number of RS-bus pulses and triggers an interrupt once the counter "matches"
 // the RS-bus address.
 //
@@ -72,6 +76,9 @@
 // if the counter value matches 130. If this is not the case, a new initialisation takes place.
 // If the RS-bus address has changed, CheckPolling() will load the Compare register (TCBx.CCMP)
 // to refelct the new RS-bus address
+// If the decoder uses multiple addresses (RSbusConnection objects), each connection has its own
+// transmit slot. CheckPolling() loads TCBx.CCMP with the lowest address that has data waiting, and
+// after that slot has been served the ISR loads the next address from the schedule (see sup_isr.cpp).
 // 
 // RS-Bus input pin
 // ================
@@ -113,14 +120,6 @@ static volatile TCB_t* _timer;       // In init and detach we use a pointer to t
 // RSbusIsr: constructor
 //******************************************************************************************************
 RSbusIsr::RSbusIsr(void) {       // Define the constructor
-  lastPulseCnt = 0;              // Any value
-  data4IsrFlag = false;          // ISR acts on data4IsrFlag, instead of data2sendFlag
-  address2use = 0;               // Initialise address to 0
-  data2send = 0;                 // Empty our send data byte
-  data2sendFlag = false;         // No, we don't have anything to send yet
-  dataWasSendFlag = false;       // No, we didn't send anything yet
-  flagParity = false;            // No, we don't need to retranmit after a parity error
-  flagPulseCount = false;        // No, we don't need to retranmit after a pulse count error
   tLastCheck = micros();         // Current time
 }
 
@@ -180,7 +179,7 @@ void RSbusHardware::initTcb(void) {
   _timer->CTRLB = TCB_CNTMODE_INT_gc;                  // Periodic Interrupt Mode
   _timer->EVCTRL = TCB_CAPTEI_bm | TCB_FILTER_bm;      // Enable input capture events and noise cancelation
   _timer->INTCTRL |= TCB_CAPT_bm;                      // Enable CAPT interrupts
-  _timer->CCMP = rsISR.address2use;                    // Initial RS-Bus address
+  _timer->CCMP = rsISR.ccmpValue;                      // Initial RS-Bus address
   interrupts();
 }
 
@@ -207,14 +206,13 @@ void RSbusHardware::initEventSystem(uint8_t rxPin) {
 }
 
 
-RSbusHardware::RSbusHardware() {                     // Constructor
-  rsSignalIsOK = false;                              // No valid RS-bus signal detected yet
-  swapUsartPin = false;                              // We use the default USART TX pin
-  interruptModeRising = true;                        // Earlier hardware triggered on FALLING
-  parityErrors = 0;                                  // Counter for the number of 10,7ms gaps
-  pulseCountErrors = 0;                              // Number of times a cycli did not have 130 pulses
-  parityErrorHandling = 1;                           // Default: if we have just send data, retransmit!
-  pulseCountErrorHandling = 2;                       // Default: always retransmit all feedback data
+RSbusHardware::RSbusHardware(uint8_t busNumber) {    // Constructor
+  bus = busNumber;                                   // Always 0: this variant supports a single bus
+  isr = &rsISR;
+  clearTelemetry();                                  // Set all telemetry counters to 0
+  #if defined(RSBUS_STATISTICS)
+  clearStatistics();
+  #endif
 }
 
 
@@ -226,6 +224,9 @@ void RSbusHardware::attach(uint8_t usartNumber, uint8_t rxPin) {
   rsUSART.init(usartNumber, !swapUsartPin);          // RS-bus transmission hardware (USART)
   initTcb();
   initEventSystem(rxPin);
+  #if defined(RSBUS_SILENCE_TIMER)
+  init_timerx();                                     // A timer calls resetAddressPolled() every 2ms
+  #endif
 }
 
 
@@ -241,31 +242,12 @@ void RSbusHardware::detach(void) {
   _timer->CNT = 0;
   _timer->INTFLAGS = 0;
   interrupts();
+  #if defined(RSBUS_SILENCE_TIMER)
+  stop_timerx();
+  #endif
 }
 
 
-//******************************************************************************************************
-void RSbusHardware::triggerRetransmission(uint8_t strategy, bool justTransmitted) {
-  // Retransmissions can be triggered by clearing the rsSignalIsOK flag.
-  // If this flag is cleared, checkConnection() sets the status to 'notSynchronised'
-  // empties the FIFO and clears the data2SendFlag.
-  // This will trigger the main sketch to retransmit (all 8 bits of) feedback data
-  switch (strategy) {
-    case 0:                                  // Do nothing
-    break;
-    case 1:                                  // Signal an error if we just transmitted
-      if (justTransmitted) rsSignalIsOK = false;
-    break;
-    case 2:                                  // Always signal an error
-      rsSignalIsOK = false;                  // Will trigger a retransmission
-    break;
-    default:                                 // Ignore
-    break;
-  }
-  // If the application will retransmit, we can cancel data ready for transmission
-  if (rsSignalIsOK == false) rsISR.data4IsrFlag = false;
-}
-
 //******************************************************************************************************
 // checkPolling(): Called from main as frequent as possible
 //******************************************************************************************************
@@ -279,61 +261,87 @@ void RSbusHardware::triggerRetransmission(uint8_t strategy, bool justTransmitted
 // - check 6: ignore 
 // - check 7: 12ms of silence: seems we lost the RS-signal
 void RSbusHardware::checkPolling(void) {
+  RSBUS_STATS_START
+  #if !defined(RSBUS_SILENCE_TIMER)
+  // Skip the following code, since a timer calls resetAddressPolled() every 2ms
   unsigned long currentTime = micros();                // will not chance during sub routine
   if ((currentTime - rsISR.tLastCheck) >= 2000) {      // Check once every 2 ms
     rsISR.tLastCheck = currentTime;
-    uint16_t currentCnt = timer_CNT;                   // will not chance during sub routine
-    if (currentCnt == rsISR.lastPulseCnt) {            // This may be a silence period
-      rsISR.timeIdle++;                                // Counts which 2ms check we are in
-      switch (rsISR.timeIdle) {                        // See figures above
-      case 1:                                          // RTC.CNT differs from previous count
-      case 2:                                          // May also occur if UART send byte 
-      case 4:                                          // Same as case 3, nothing new
-      case 6:                                          // Same as case 5, nothing new
-      break;
-      case 3:                                          // Third check => SILENCE!
-        rsISR.flagPulseCount = rsISR.dataWasSendFlag;  // ISR may set the dataWasSendFlag
-        rsISR.flagParity     = rsISR.dataWasSendFlag;  // and flags may trigger retransmission
-        rsISR.dataWasSendFlag = false;                 // but only is previous cycle had errors
-        if (timer_CNT == 130) {
-          rsSignalIsOK = true;
-          timer_CNT = 0;                               // Start a new polling cycle
-          rsISR.lastPulseCnt = 0;                      // Update as well, since we still have silence
-          if (rsISR.data2sendFlag) {
-            timer_CCMP = rsISR.address2use;            // The RS-bus address may be changed
-            rsISR.ccmpValue = rsISR.address2use;       // For the ISR to reinitialise TCBx.CNT
-            rsISR.data4IsrFlag = true;                 // Tell the ISR that data may be send
-          }
-        }
-        else {
-          timer_CNT = 0;                               // Start a new polling cycle
-          rsISR.lastPulseCnt = 0;                      // Update as well, since we still have silence
-          if (rsSignalIsOK) {                          // Do nothing during initialisation
-            pulseCountErrors ++;
-            triggerRetransmission(pulseCountErrorHandling, rsISR.flagPulseCount);
-          }
+    resetAddressPolled();
+  }
+  #endif
+  checkEvents();                                       // Callbacks and serviceConnections
+  RSBUS_STATS_STOP(checkPolling)
+}
+
+
+void RSbusHardware::resetAddressPolled(void) {
+  RSBUS_STATS_START
+  uint16_t currentCnt = timer_CNT;                     // will not chance during sub routine
+  if (currentCnt == rsISR.lastPulseCnt) {              // This may be a silence period
+    rsISR.timeIdle++;                                  // Counts which 2ms check we are in
+    switch (rsISR.timeIdle) {                          // See figures above
+    case 1:                                            // RTC.CNT differs from previous count
+    case 2:                                            // May also occur if UART send byte 
+    case 4:                                            // Same as case 3, nothing new
+    case 6:                                            // Same as case 5, nothing new
+    break;
+    case 3:                                            // Third check => SILENCE!
+      rsISR.flagPulseCount = rsISR.dataWasSendFlag;    // ISR may set the dataWasSendFlag
+      rsISR.flagParity     = rsISR.dataWasSendFlag;    // and flags may trigger retransmission
+      rsISR.dataWasSendFlag = false;                   // but only is previous cycle had errors
+      rsISR.sentLastCycle = rsISR.sentMask;            // The bytes that selective retransmission
+      rsISR.sentMask = 0;                              // may send again
+      if (timer_CNT == 130) {
+        rsSignalIsOK = true;
+        cycleStarted(true);
+        timer_CNT = 0;                                 // Start a new polling cycle
+        rsISR.lastPulseCnt = 0;                        // Update as well, since we still have silence
+        rsISR.armSlots(rsISR.data2sendMask, 1);       // Tell the ISR that data may be send
+        if (rsISR.nextAddress) {                       // At least one slot has data waiting
+          timer_CCMP = rsISR.nextAddress;              // The RS-bus address may be changed
+          rsISR.ccmpValue = rsISR.nextAddress;         // For the ISR to reinitialise TCBx.CNT
         }
-      break;
-      case 5:                                          // 8ms of silence
-        if (rsSignalIsOK) {                            // Only act if everything was OK before
-          parityErrors++;                              // Keep track of number of parity errors
-          triggerRetransmission(parityErrorHandling, rsISR.flagParity);
+      }
+      else {
+        timer_CNT = 0;                                 // Start a new polling cycle
+        rsISR.lastPulseCnt = 0;                        // Update as well, since we still have silence
+        cycleStarted(false);                           // Telemetry: the previous cycle was not valid
+        if (rsSignalIsOK) {                            // Do nothing during initialisation
+          pulseCountErrors ++;
+          countError(telemetry.pulseCountErrors);
+          triggerRetransmission(pulseCountErrorHandling, rsISR.flagPulseCount);
         }
-      break;
-      case 7:                                          // 12ms of silence
-        if (rsSignalIsOK) parityErrors--;              // Wasn't a parity error
-        rsSignalIsOK = false;                          // But worse: a RS-bus signal loss
-        rsISR.data4IsrFlag = false;                    // Cancel possible data waiting for ISR
-      break;
-      default:                                         // Silence >= 14ms
-      break;
-      };
-    }
-    else {                                             // Not a silence period
-      rsISR.lastPulseCnt = currentCnt;                 // CNT can have any value <= 129
-      rsISR.timeIdle = 1;                              // Reset silence (idle) period counter
+      }
+    break;
+    case 5:                                            // 8ms of silence
+      if (rsSignalIsOK) {                              // Only act if everything was OK before
+        parityErrors++;                                // Keep track of number of parity errors
+        parityPending = true;                          // Telemetry: counted once the silence ends
+        triggerRetransmission(parityErrorHandling, rsISR.flagParity);
+      }
+    break;
+    case 7:                                            // 12ms of silence
+      if (parityPending) parityErrors--;               // Wasn't a parity error
+      if (rsSignalIsOK || parityPending) rsCount(telemetry.signalLosses);
+      parityPending = false;                           // Not a parity error after all
+      cycleValid = false;                              // The next cycle doesn't follow a valid cycle
+      rsSignalIsOK = false;                            // But worse: a RS-bus signal loss
+      rsISR.data4IsrMask = 0;                          // Cancel possible data waiting for ISR
+    break;
+    default:                                           // Silence >= 14ms
+    break;
+    };
+  }
+  else {                                               // Not a silence period
+    rsISR.lastPulseCnt = currentCnt;                   // CNT can have any value <= 129
+    rsISR.timeIdle = 1;                                // Reset silence (idle) period counter
+    if (parityPending) {                               // The silence was 8..12ms: parity error
+      parityPending = false;
+      countError(telemetry.parityErrors);
     }
   }
+  RSBUS_STATS_STOP(resetAddressPolled)
 }
 
 
@@ -352,17 +360,34 @@ void RSbusHardware::checkPolling(void) {
 #elif defined(RSBUS_USES_HW_TCB4)
   ISR(TCB4_INT_vect) {
 #endif
-  // Note: the ISR automatically clears the pulse counter TCBx.CNT
+  RSBUS_STATS_START
+  // Note: the ISR automatically clears the pulse counter TCBx.CNT. If the ISR started late (for example
+  // since other interrupts were being served), the next pulse(s) have already been counted. In that case
+  // the slot of our address has passed, and sending now would corrupt the byte of the next slave.
+  uint8_t lateCount = timer_CNT;          // Pulses received after the match. Normally 0
   timer_INTFLAGS |= TCB_CAPT_bm;          // We had an interrupt. Clear!
-  timer_CNT = rsISR.ccmpValue + 1;        // Revert clearing the pulse counter
-  if (rsISR.data4IsrFlag) {
-    // We have data to send, it is our turn and the decoder is synchronised
-    // Note: general USART code often includes some kind of flow control, but that is not needed here
-    *rsUSART.dataRegister = rsISR.data2send;
-    rsISR.data2sendFlag = false;         // RSbusConnection::sendNibble may now prepare new data
-    rsISR.dataWasSendFlag = true;        // used to trigger retransmission after arrors
-    rsISR.data4IsrFlag = false;          // CheckPolling may now select a new RS-bus address
+  timer_CNT = rsISR.ccmpValue + 1 + lateCount; // Revert clearing the pulse counter
+  if ((rsISR.scheduleIndex < rsISR.scheduleSize) && (rsISR.ccmpValue == rsISR.nextAddress)) {
+    uint8_t slot = rsISR.schedule[rsISR.scheduleIndex];
+    uint8_t slotBit = (1 << slot);
+    if (rsISR.data4IsrMask & slotBit) {
+      // We have data to send, it is our turn and the decoder is synchronised
+      // Note: general USART code often includes some kind of flow control, but that is not needed here
+      if (lateCount == 0) {
+        *rsUSART.dataRegister = rsISR.slotPop(slot); // Clears the slot bit if the queue is empty
+        rsISR.dataWasSendFlag = true;      // used to trigger retransmission after arrors
+      }
+      else if (rsISR.lateSkips != 0xFFFFFFFF) rsISR.lateSkips++; // Keep the nibble for the next cycle
+      rsISR.data4IsrMask &= ~slotBit;      // CheckPolling may now select a new RS-bus address
+    }
+    // Load the next RS-bus address that has data waiting within this polling cycle
+    rsISR.nextSlot();
+    if (rsISR.nextAddress) {
+      timer_CCMP = rsISR.nextAddress;
+      rsISR.ccmpValue = rsISR.nextAddress;
+    }
   } 
+  RSBUS_STATS_STOP(isr)
 }
 
 #endif // #if defined(RSBUS_USES_HW_TCB....)
@@ -0,0 +1,343 @@
+//******************************************************************************************************
+//
+// file:      sup_isr_hw_tx.cpp
+// purpose:   Support file for the RS-bus library.
+//            Defines the Interrupt Service routine (ISR) that counts the polling pulses transmitted by
+//            the master. Once this decoder is polled, the ISR can send data back via its USART.
+//            Uses a 16 bit Timer (1, 3, 4 or 5) of traditional ATMega processors as pulse counter,
+//            clocked by the external clock input (Tn pin) of that timer.
+// history:   2026-10-14 ag V1.0 initial version
+//
+// This source file is subject of the GNU general public license 3,
+// that is available at the world-wide-web at http://www.gnu.org/licenses/gpl.txt
+//
+// If data is available for sending, the data should be added to the slot's queue with slotPush(),
+// which also sets the slot's bit in "data2sendMask".
+// The timer counter (TCNTn) counts the number of RS-bus pulses and once the counter value matches the
+// compare value (OCRnA), an interrupt is raised and the data will be send.
+//
+// Timer with external clock - Introduction
+// ========================================
+// The software based variants (RSBUS_USES_SW and SW_Tx) raise an interrupt for each of the 130 pulses
+// of a polling cycle. The 16 bit timers of traditional ATMega processors however can also be clocked
+// by their external clock input pin (Tn), instead of by the prescaled system clock. If the Clock Select
+// bits (CSn2:0) in TCCRnB are 7, the counter is incremented at each rising edge of the Tn pin, and
+// if these bits are 6, at each falling edge. The Tn pin is sampled once every system clock cycle, thus
+// the pulses should last at least 2 system clock cycles; the RS-bus pulses are much longer.
+// The edge detector adds a delay of 2,5 to 3,5 system clock cycles, which is negligible.
+//
+// Normal mode and Compare Match
+// -----------------------------
+// The timer is used in Normal mode, thus it counts up to 0xFFFF and never overflows during a polling
+// cycle. If the counter equals OCRnA, the compare flag (OCFnA) is set at the next timer clock cycle,
+// which is the next RS-bus pulse. The master polls address A with pulse A+1, thus OCRnA is loaded with
+// the address itself, and an ISR that runs in time sees TCNTn == A+1. A compare match doesn't clear
+// the counter, thus the ISR doesn't need to revert the counter, and after a complete pulse train (thus
+// at the start of the silence period) the counter value is 130. Instead of 130 interrupts per polling
+// cycle, only one interrupt per address that has data waiting remains.
+//
+// Timer initialisation
+// --------------------
+// The counter will be reset by CheckPolling() during the silence period. This ensures that the
+// counter value is zero when the next pulse train starts.
+// Initialisation is also needed after start-up or after the RS-bus signal was lost and reappears.
+// To determine if initialisation is needed, checks are performed during the silence period
+// if the counter value matches 130. If this is not the case, a new initialisation takes place.
+// If the decoder uses multiple addresses (RSbusConnection objects), each connection has its own
+// transmit slot. CheckPolling() loads OCRnA for the lowest address that has data waiting, and after
+// that slot has been served the ISR loads the next address from the schedule (see sup_isr.cpp).
+// The timer runs synchronous to the system clock, thus the next address may directly follow the
+// address just served.
+//
+// Note that TCNTn and OCRnA are 16 bit registers, which are accessed via the TEMP register that is
+// shared by all 16 bit timers. Since the ISR accesses these registers as well, the main loop reads
+// and writes them with interrupts disabled.
+//
+// RS-Bus input pin
+// ================
+// The RS-bus input MUST be connected to the Tn pin of the selected timer; the rxPin parameter of
+// attach() is not used. On the 328 (UNO, Nano) T1 is PD5 (Arduino pin 5). On the 2560 T5 is PL2
+// (Arduino pin 47); T1 (PD6), T3 (PE6) and T4 (PH7) exist, but aren't available on the Arduino Mega
+// board. On the 32U4 (Leonardo) T1 is PD6 (Arduino pin 12).
+// Dependent on interruptModeRising, rising or falling edges are counted.
+//
+// Timer 1 of the 328 is also used by the Servo library, tone(), and analogWrite() on pins 9 and 10.
+// These can not be used in combination with RSBUS_USES_HW_T1.
+//
+// Parity errors
+// =============
+// If the master station detects a parity error, it will enlarge the silence period
+//
+// Pins:
+// =====
+// - Tn: RS-Bus in
+// - a transmit pin for the UART
+//
+//******************************************************************************************************
+#include <Arduino.h>
+#include "RSbus.h"
+#include "sup_isr.h"
+#include "sup_usart.h"
+
+// This code will only be used if we define in RSbusVariants.h the "RSBUS_USES_HW_Tx" directive
+#if defined(RSBUS_USES_HW_T1) || defined(RSBUS_USES_HW_T3) || defined(RSBUS_USES_HW_T4) || \
+    defined(RSBUS_USES_HW_T5)
+
+//******************************************************************************************************
+// The following objects are instantiated elsewhere, but are used here
+extern RSbusHardware rsbusHardware;  // instantiated in "RS-bus.cpp"
+extern volatile RSbusIsr rsISR;      // instantiated in "RS-bus.cpp"
+extern USART rsUSART;                // instantiated in "sup_usart.cpp" We only use init()
+
+
+// The registers of the selected timer are directly accessed via #defines
+#if defined(RSBUS_USES_HW_T1)
+  #define timer_TCCRA    TCCR1A
+  #define timer_TCCRB    TCCR1B
+  #define timer_TCNT     TCNT1
+  #define timer_OCR      OCR1A
+  #define timer_OCIE     OCIE1A
+  #define timer_OCF      OCF1A
+  #ifdef TIMSK                       // ATmega 8535/16/32: TIMSK and TIFR control multiple timers
+    #define timer_TIMSK  TIMSK
+    #define timer_TIFR   TIFR
+  #else
+    #define timer_TIMSK  TIMSK1
+    #define timer_TIFR   TIFR1
+  #endif
+#elif defined(RSBUS_USES_HW_T3)
+  #define timer_TCCRA    TCCR3A
+  #define timer_TCCRB    TCCR3B
+  #define timer_TCNT     TCNT3
+  #define timer_OCR      OCR3A
+  #define timer_OCIE     OCIE3A
+  #define timer_OCF      OCF3A
+  #define timer_TIMSK    TIMSK3
+  #define timer_TIFR     TIFR3
+#elif defined(RSBUS_USES_HW_T4)
+  #define timer_TCCRA    TCCR4A
+  #define timer_TCCRB    TCCR4B
+  #define timer_TCNT     TCNT4
+  #define timer_OCR      OCR4A
+  #define timer_OCIE     OCIE4A
+  #define timer_OCF      OCF4A
+  #define timer_TIMSK    TIMSK4
+  #define timer_TIFR     TIFR4
+#elif defined(RSBUS_USES_HW_T5)
+  #define timer_TCCRA    TCCR5A
+  #define timer_TCCRB    TCCR5B
+  #define timer_TCNT     TCNT5
+  #define timer_OCR      OCR5A
+  #define timer_OCIE     OCIE5A
+  #define timer_OCF      OCF5A
+  #define timer_TIMSK    TIMSK5
+  #define timer_TIFR     TIFR5
+#endif
+
+#define EXT_CLOCK_RISING   0x07      // CSn2:0: external clock on Tn pin, rising edge
+#define EXT_CLOCK_FALLING  0x06      // CSn2:0: external clock on Tn pin, falling edge
+
+
+//******************************************************************************************************
+// RSbusIsr: constructor
+//******************************************************************************************************
+RSbusIsr::RSbusIsr(void) {       // Define the constructor
+  tLastCheck = micros();         // Current time
+}
+
+
+//******************************************************************************************************
+//******************************************************************************************************
+// The RSbusHardware class is responsible for controlling the RS-bus hardware, thus the Timer that counts
+// the polling pulses send by the master, and the USART connected to an output pin to send messages
+// to the master.
+// Messages are: 8 bit, no parity, 1 stop bit, asynchronous mode, 4800 baud.
+// The "attach" method initialises the Timer and USART.
+// A detach method is available to disable the Timer, which is needed before a decoder gets restarted.
+// Note regarding the code: instead of the "RSbusHardware::attach" method we could have directly used
+// the RSbusIsr and USART class constructors. However, since we also need a "RSbusHardware::detach" method
+// to stop the rs_interrupt service routine, for symmetry reasons we have decided for an "attach"
+// and "detach".
+
+RSbusHardware::RSbusHardware(uint8_t busNumber) {    // Constructor
+  bus = busNumber;                                   // Always 0: this variant supports a single bus
+  isr = &rsISR;
+  clearTelemetry();                                  // Set all telemetry counters to 0
+  #if defined(RSBUS_STATISTICS)
+  clearStatistics();
+  #endif
+}
+
+
+void RSbusHardware::attach(uint8_t usartNumber, uint8_t rxPin) {
+  rxPinUsed = rxPin;                                 // Not used: the RS-bus input is the Tn pin
+  // Step 1: Initialise the RS bus transmission hardware (USART)
+  rsUSART.init(usartNumber, !swapUsartPin);
+  // Step 2: Initialise the Timer in Normal mode, clocked by the Tn pin
+  noInterrupts();
+  timer_TCCRA = 0x00;                                // Normal mode, no waveform outputs
+  timer_TCCRB = 0x00;                                // Stop the timer (needed to setup)
+  timer_TCNT = 0;
+  timer_OCR = rsISR.ccmpValue;                       // Initial RS-Bus address
+  timer_TIFR = (1 << timer_OCF);                     // Clear a possible old Compare Match
+  timer_TIMSK |= (1 << timer_OCIE);                  // Enable Compare Match A interrupts
+  if (interruptModeRising) timer_TCCRB = EXT_CLOCK_RISING;
+    else timer_TCCRB = EXT_CLOCK_FALLING;            // Start counting RS-bus pulses
+  interrupts();
+}
+
+
+void RSbusHardware::detach(void) {
+  noInterrupts();
+  // For "reboot" (jmp 0) it is crucial to disable the interrupt
+  timer_TCCRB = 0x00;                                // 0 = stop
+  timer_TIMSK &= ~(1 << timer_OCIE);
+  timer_TIFR = (1 << timer_OCF);
+  interrupts();
+}
+
+
+//******************************************************************************************************
+// checkPolling(): Called from main as frequent as possible
+//******************************************************************************************************
+// See for details: ../extras/BasicOperation-CheckPolling.md
+// The timer counts the RS-bus pulses, thus (as opposed to RSBUS_USES_SW_Tx) no timer is left to call
+// resetAddressPolled(). The main loop should therefore call checkPolling() at least every 2ms.
+// CheckPolling() ignores all checks, except check 3 and check 5
+// - check 1: ignore
+// - check 2: ignore
+// - check 3: TCNTn should be 130 => reinitialise values, including RS-bus address and flags
+// - check 4: ignore
+// - check 5: only happens after more than 8ms of silence: parity error (or signal loss)
+// - check 6: ignore
+// - check 7: 12ms of silence: seems we lost the RS-signal
+void RSbusHardware::checkPolling(void) {
+  RSBUS_STATS_START
+  unsigned long currentTime = micros();                // will not chance during sub routine
+  if ((currentTime - rsISR.tLastCheck) >= 2000) {      // Check once every 2 ms
+    rsISR.tLastCheck = currentTime;
+    resetAddressPolled();
+  }
+  checkEvents();                                       // Callbacks and serviceConnections
+  RSBUS_STATS_STOP(checkPolling)
+}
+
+
+void RSbusHardware::resetAddressPolled(void) {
+  RSBUS_STATS_START
+  uint8_t oldSREG = SREG;                              // Keeps the interrupt state of the caller
+  noInterrupts();                                      // ISRs also use the TEMP register
+  uint16_t currentCnt = timer_TCNT;                    // will not chance during sub routine
+  SREG = oldSREG;
+  if (currentCnt == rsISR.lastPulseCnt) {              // This may be a silence period
+    rsISR.timeIdle++;                                  // Counts which 2ms check we are in
+    switch (rsISR.timeIdle) {                          // See figures above
+    case 1:                                            // TCNTn differs from previous count
+    case 2:                                            // May also occur if UART send byte
+    case 4:                                            // Same as case 3, nothing new
+    case 6:                                            // Same as case 5, nothing new
+    break;
+    case 3:                                            // Third check => SILENCE!
+      rsISR.flagPulseCount = rsISR.dataWasSendFlag;    // ISR may set the dataWasSendFlag
+      rsISR.flagParity     = rsISR.dataWasSendFlag;    // and flags may trigger retransmission
+      rsISR.dataWasSendFlag = false;                   // but only is previous cycle had errors
+      rsISR.sentLastCycle = rsISR.sentMask;            // The bytes that selective retransmission
+      rsISR.sentMask = 0;                              // may send again
+      if (currentCnt == 130) {
+        rsSignalIsOK = true;
+        cycleStarted(true);
+        rsISR.armSlots(rsISR.data2sendMask, 1);        // Tell the ISR that data may be send
+        noInterrupts();
+        timer_TCNT = 0;                                // Start a new polling cycle
+        if (rsISR.nextAddress) {                       // At least one slot has data waiting
+          timer_OCR = rsISR.nextAddress;               // The RS-bus address may be changed
+          rsISR.ccmpValue = rsISR.nextAddress;         // For the ISR to compare against the schedule
+        }
+        SREG = oldSREG;
+        rsISR.lastPulseCnt = 0;                        // Update as well, since we still have silence
+      }
+      else {
+        noInterrupts();
+        timer_TCNT = 0;                                // Start a new polling cycle
+        SREG = oldSREG;
+        rsISR.lastPulseCnt = 0;                        // Update as well, since we still have silence
+        cycleStarted(false);                           // Telemetry: the previous cycle was not valid
+        if (rsSignalIsOK) {                            // Do nothing during initialisation
+          pulseCountErrors ++;
+          countError(telemetry.pulseCountErrors);
+          triggerRetransmission(pulseCountErrorHandling, rsISR.flagPulseCount);
+        }
+      }
+    break;
+    case 5:                                            // 8ms of silence
+      if (rsSignalIsOK) {                              // Only act if everything was OK before
+        parityErrors++;                                // Keep track of number of parity errors
+        parityPending = true;                          // Telemetry: counted once the silence ends
+        triggerRetransmission(parityErrorHandling, rsISR.flagParity);
+      }
+    break;
+    case 7:                                            // 12ms of silence
+      if (parityPending) parityErrors--;               // Wasn't a parity error
+      if (rsSignalIsOK || parityPending) rsCount(telemetry.signalLosses);
+      parityPending = false;                           // Not a parity error after all
+      cycleValid = false;                              // The next cycle doesn't follow a valid cycle
+      rsSignalIsOK = false;                            // But worse: a RS-bus signal loss
+      rsISR.data4IsrMask = 0;                          // Cancel possible data waiting for ISR
+    break;
+    default:                                           // Silence >= 14ms
+    break;
+    };
+  }
+  else {                                               // Not a silence period
+    rsISR.lastPulseCnt = currentCnt;                   // CNT can have any value <= 130
+    rsISR.timeIdle = 1;                                // Reset silence (idle) period counter
+    if (parityPending) {                               // The silence was 8..12ms: parity error
+      parityPending = false;
+      countError(telemetry.parityErrors);
+    }
+  }
+  RSBUS_STATS_STOP(resetAddressPolled)
+}
+
+
+//******************************************************************************************************
+// Define the Timer-based Interrupt Service routine (ISR) for the RS-bus
+//******************************************************************************************************
+// Select the corresponding ISR. The Compare Match flag is cleared by hardware once the ISR starts
+#if defined(RSBUS_USES_HW_T1)
+  ISR(TIMER1_COMPA_vect) {
+#elif defined(RSBUS_USES_HW_T3)
+  ISR(TIMER3_COMPA_vect) {
+#elif defined(RSBUS_USES_HW_T4)
+  ISR(TIMER4_COMPA_vect) {
+#elif defined(RSBUS_USES_HW_T5)
+  ISR(TIMER5_COMPA_vect) {
+#endif
+  RSBUS_STATS_START
+  // Note: the compare match doesn't clear the pulse counter. If the ISR started late (for example since
+  // other interrupts were being served), the next pulse(s) have already been counted. In that case the
+  // slot of our address has passed, and sending now would corrupt the byte of the next slave.
+  if ((rsISR.scheduleIndex < rsISR.scheduleSize) && (rsISR.ccmpValue == rsISR.nextAddress)) {
+    uint8_t slot = rsISR.schedule[rsISR.scheduleIndex];
+    uint8_t slotBit = (1 << slot);
+    if (rsISR.data4IsrMask & slotBit) {
+      // We have data to send, it is our turn and the decoder is synchronised
+      // Note: general USART code often includes some kind of flow control, but that is not needed here
+      if (timer_TCNT == rsISR.ccmpValue + 1) {
+        *rsUSART.dataRegister = rsISR.slotPop(slot); // Clears the slot bit if the queue is empty
+        rsISR.dataWasSendFlag = true;      // used to trigger retransmission after arrors
+      }
+      else if (rsISR.lateSkips != 0xFFFFFFFF) rsISR.lateSkips++; // Keep the nibble for the next cycle
+      rsISR.data4IsrMask &= ~slotBit;      // CheckPolling may now select a new RS-bus address
+    }
+    // Load the next RS-bus address that has data waiting within this polling cycle
+    rsISR.nextSlot();
+    if (rsISR.nextAddress) {
+      timer_OCR = rsISR.nextAddress;
+      rsISR.ccmpValue = rsISR.nextAddress;
+    }
+  }
+  RSBUS_STATS_STOP(isr)
+}
+
+#endif // #if defined(RSBUS_USES_HW_Tx)
@@ -9,6 +9,10 @@
 //            2021-10-12 ap V1.0 Check every 2ms and ability to detect parity errors
 //            2022-07-26 ap V1.1 Added support for Timer 1. Added F_CPU to prescaler
 //            2022-07-27 ap V1.2 millis() replaced by micros()
+//            2026-10-14 ag V1.3 Transmit slots per RSbusConnection, a single compare per pulse
+//                               The ISR takes the data from the slot's queue
+//                               Optional: pin change interrupt vector instead of attachInterrupt()
+//                               Specialised ISR for RSBUS_FIXED_ADDRESS
 //
 // This source file is subject of the GNU general public license 3,
 // that is available at the world-wide-web at http://www.gnu.org/licenses/gpl.txt
@@ -19,9 +23,12 @@
 // Such transistion indicates that the next feedback decoder is allowed to send information.
 // To determine which decoder has its turn, the ISR increments at each transition the
 // 'addressPolled' variable. 
-// If data is made available by the main sketch (the 'data2sendFlag' is set and the data has been
-// entered into the 'data2send' variable), the data will be send once the 'addressPolled' variable
-// matches the address ('address2use') of this decoder (with offset 1).
+// Each RSbusConnection object has its own transmit slot. If data is made available for a slot (the
+// data has been added to the slot's queue, and the slot's bit in 'data2sendMask' is set), the data
+// will be send once the 'addressPolled' variable matches the address ('address2use[slot]') of that
+// slot (with offset 1). In this way every address of this decoder can send within the same cycle.
+// To keep the ISR short, the armed slots are sorted on address at the start of each cycle (see
+// sup_isr.cpp), so the ISR only compares 'addressPolled' against the address of the next slot.
 //
 //         <-0,2ms->                                       <-------------7ms------------->
 //    ____      ____      ____              ____      ____                                 ____
@@ -39,8 +46,17 @@
 // check. If both values match, we (very likely) have a period of silence.
 // See for details: ../extras/BasicOperation-CheckPolling.md
 //
+// attachInterrupt() calls rs_interrupt() via a function pointer. Before the call, the ISR of the
+// Arduino core therefore has to save all call-used registers, which costs many cycles per pulse.
+// If RSBUS_SW_PCINT is defined (see RSbusVariants.h), the Pin Change Interrupt vectors are used
+// instead, and the ISR body is inlined directly in these vectors. Since a Pin Change Interrupt
+// triggers at both edges, the ISR checks the pin level to count only the RISING (or FALLING) edges.
+// Note that other libraries that use Pin Change Interrupts, such as SoftwareSerial, can not be used
+// in combination with RSBUS_SW_PCINT.
+//
 // Used hardware and software:
 // - INTx: used to receive RS-bus information from the command station
+// - PCINTx: instead of INTx, if RSBUS_SW_PCINT is defined (any pin can be used)
 // - TXD/TXDx: used to send RS-bus information to the command station (USART)
 // - Timer3 (1,,3, 4 or 5): If we have a 2560 processor
 //
@@ -60,19 +76,17 @@ extern RSbusHardware rsbusHardware;  // instantiated in "RS-bus.cpp"
 extern volatile RSbusIsr rsISR;      // instantiated in "RS-bus.cpp"
 extern USART rsUSART;                // instantiated in "sup_usart.cpp" We only use init()
 
+#if defined(RSBUS_SW_PCINT)
+static volatile uint8_t *rxPort;     // PIN register of the RS-bus input pin
+static uint8_t rxMask;               // Bit of the RS-bus input pin within that register
+static uint8_t rxLevel;              // Pin value after the edge that should be counted
+#endif
+
 
 //******************************************************************************************************
 // RSbusIsr: constructor
 //******************************************************************************************************
 RSbusIsr::RSbusIsr(void) {       // Define the constructor
-  addressPolled = 0;             // Start with any address; the first polling cyclus will not be used
-  lastPulseCnt = 0;              // Any value
-  address2use = 0;               // Initialise address to 0
-  data2send = 0;                 // Empty our send data byte
-  data2sendFlag = false;         // No, we don't have anything to send yet
-  dataWasSendFlag = false;       // No, we didn't send anything yet
-  flagParity = false;            // No, we don't need to retranmit after a parity error
-  flagPulseCount = false;        // No, we don't need to retranmit after a pulse count error
   tLastCheck = micros();         // Current time
 }
 
@@ -91,14 +105,13 @@ RSbusIsr::RSbusIsr(void) {       // Define the constructor
 // to stop the rs_interrupt service routine, for symmetry reasons we have decided for an 'attach'
 // and 'detach'.
 
-RSbusHardware::RSbusHardware() {                     // Constructor
-  rsSignalIsOK = false;                              // No valid RS-bus signal detected yet
-  swapUsartPin = false;                              // We use the default USART TX pin
-  interruptModeRising = true;                        // Earlier hardware triggered on FALLING
-  parityErrors = 0;                                  // Counter for the number of 10,7ms gaps
-  pulseCountErrors = 0;                              // Number of times a cycli did not have 130 pulses
-  parityErrorHandling = 1;                           // Default: if we have just send data, retransmit!
-  pulseCountErrorHandling = 2;                       // Default: always retransmit all feedback data
+RSbusHardware::RSbusHardware(uint8_t busNumber) {    // Constructor
+  bus = busNumber;                                   // Always 0: this variant supports a single bus
+  isr = &rsISR;
+  clearTelemetry();                                  // Set all telemetry counters to 0
+  #if defined(RSBUS_STATISTICS)
+  clearStatistics();
+  #endif
 }
 
 void RSbusHardware::attach(uint8_t usartNumber, uint8_t rxPin) {
@@ -108,40 +121,34 @@ void RSbusHardware::attach(uint8_t usartNumber, uint8_t rxPin) {
   // Use swapUsartPin to set the defaultUsartPins parameter.
   rsUSART.init(usartNumber, !swapUsartPin);
   // Step 2: attach the interrupt to the RSBUS_RX pin.
+  #if defined(RSBUS_SW_PCINT)
+  rxPort = portInputRegister(digitalPinToPort(rxPin));
+  rxMask = digitalPinToBitMask(rxPin);
+  if (interruptModeRising) rxLevel = rxMask;         // After a RISING edge the pin is high
+    else rxLevel = 0;
+  noInterrupts();
+  *digitalPinToPCMSK(rxPin) |= (1 << digitalPinToPCMSKbit(rxPin));
+  PCIFR = (1 << digitalPinToPCICRbit(rxPin));        // Clear a possible old interrupt
+  *digitalPinToPCICR(rxPin) |= (1 << digitalPinToPCICRbit(rxPin));
+  interrupts();
+  #else
   if (interruptModeRising) attachInterrupt(digitalPinToInterrupt(rxPin), rs_interrupt, RISING);
   else attachInterrupt(digitalPinToInterrupt(rxPin), rs_interrupt, FALLING);
+  #endif
   // Step 3: In case we use a 2560 processor, Timer3 (4 or 5) is used to reset addressPolled
   init_timerx();
 }
 
 void RSbusHardware::detach(void) {
+  #if defined(RSBUS_SW_PCINT)
+  *digitalPinToPCMSK(rxPinUsed) &= ~(1 << digitalPinToPCMSKbit(rxPinUsed));
+  #else
   detachInterrupt(digitalPinToInterrupt(rxPinUsed));
+  #endif
   stop_timerx();
 }
 
 
-//******************************************************************************************************
-void RSbusHardware::triggerRetransmission(uint8_t strategy, bool justTransmitted) {
-  // Retransmissions can be triggered by clearing the rsSignalIsOK flag.
-  // If this flag is cleared, checkConnection() sets the status to 'notSynchronised'
-  // empties the FIFO and clears the data2SendFlag.
-  // This will trigger the main sketch to retransmit (all 8 bits of) feedback data
-  switch (strategy) {
-    case 0:                                  // Do nothing
-    break;
-    case 1:                                  // Signal an error if we just transmitted
-      if (justTransmitted) rsSignalIsOK = false;
-    break;
-    case 2:                                  // Always signal an error
-      rsSignalIsOK = false;                  // Will trigger a retransmission
-    break;
-    default:                                 // Ignore
-    break;
-  }
-  // If the application will retransmit, we can cancel data ready for transmission
-  if (rsSignalIsOK == false) rsISR.data4IsrFlag = false;
-}
-
 //******************************************************************************************************
 // checkPolling(): Called from main as frequent as possible
 //******************************************************************************************************
@@ -156,6 +163,7 @@ void RSbusHardware::triggerRetransmission(uint8_t strategy, bool justTransmitted
 // - check 6: same as check 5 
 // - check 7: 12ms of silence: seems we lost the RS-signal
 void RSbusHardware::checkPolling(void) {
+  RSBUS_STATS_START
   #if !defined(RSBUS_USES_SW_T1) && !defined(RSBUS_USES_SW_T3) && !defined(RSBUS_USES_SW_T4) && !defined(RSBUS_USES_SW_T5)
   // Skip the following code, since Timer 3 (4 or 5) takes over
   unsigned long currentTime = micros();                // will not chance during sub routine
@@ -164,10 +172,13 @@ void RSbusHardware::checkPolling(void) {
       resetAddressPolled();
   }
   #endif
+  checkEvents();                                       // Callbacks and serviceConnections
+  RSBUS_STATS_STOP(checkPolling)
 }
 
 
 void RSbusHardware::resetAddressPolled(void) {
+  RSBUS_STATS_START
   uint16_t currentCnt = rsISR.addressPolled;         // will not chance during sub routine
   if (currentCnt == rsISR.lastPulseCnt) {            // This may be a silence period
     rsISR.timeIdle++;                                // Counts which 2ms check we are in
@@ -182,14 +193,19 @@ void RSbusHardware::resetAddressPolled(void) {
       rsISR.flagPulseCount = rsISR.dataWasSendFlag;  // ISR may set the dataWasSendFlag
       rsISR.flagParity     = rsISR.dataWasSendFlag;  // and flags may trigger retransmission
       rsISR.dataWasSendFlag = false;                 // but only is previous cycle had errors
+      rsISR.sentLastCycle = rsISR.sentMask;          // The bytes that selective retransmission
+      rsISR.sentMask = 0;                            // may send again
       if (rsISR.addressPolled == 130) {
         // Step 2A: signal is OK, so tell ISR if data is waiting to be transmitted
         rsSignalIsOK = true;
-        if (rsISR.data2sendFlag) rsISR.data4IsrFlag = true;
+        cycleStarted(true);
+        rsISR.armSlots(rsISR.data2sendMask, 1);
       }
       else {                                         // pulse count problem
+        cycleStarted(false);                         // Telemetry: the previous cycle was not valid
         if (rsSignalIsOK) {                          // Do nothing during initialisation
           pulseCountErrors ++;
+          countError(telemetry.pulseCountErrors);
           triggerRetransmission(pulseCountErrorHandling, rsISR.flagPulseCount);
         }
       }
@@ -199,13 +215,17 @@ void RSbusHardware::resetAddressPolled(void) {
     case 5:                                          // 8ms of silence => Parity error
       if (rsSignalIsOK) {                            // Only act if everything was OK before
         parityErrors++;                              // Keep track of number of parity errors
+        parityPending = true;                        // Telemetry: counted once the silence ends
         triggerRetransmission(parityErrorHandling, rsISR.flagParity);
       }
     break;
     case 7:                                          // 12ms of silence: RS-bus signal loss
-      if (rsSignalIsOK) parityErrors--;              // Wasn't a parity error
+      if (parityPending) parityErrors--;             // Wasn't a parity error
+      if (rsSignalIsOK || parityPending) rsCount(telemetry.signalLosses);
+      parityPending = false;                         // Not a parity error after all
+      cycleValid = false;                            // The next cycle doesn't follow a valid cycle
       rsSignalIsOK = false;                          // Will trigger a reconnect to the master
-      rsISR.data4IsrFlag = false;                    // Cancel possible data waiting for ISR
+      rsISR.data4IsrMask = 0;                        // Cancel possible data waiting for ISR
     break;
     default:                                         // Silence >= 14ms
     break;
@@ -214,7 +234,12 @@ void RSbusHardware::resetAddressPolled(void) {
   else {                                             // Not a silence period
     rsISR.lastPulseCnt = currentCnt;                 // Store current addressPolled
     rsISR.timeIdle = 1;                              // Reset silence (idle) period counter
+    if (parityPending) {                             // The silence was 8..12ms: parity error
+      parityPending = false;
+      countError(telemetry.parityErrors);
+    }
   }
+  RSBUS_STATS_STOP(resetAddressPolled)
 }
 
 
@@ -222,19 +247,70 @@ void RSbusHardware::resetAddressPolled(void) {
 //******************************************************************************************************
 // Define the Interrupt Service routines (ISR) for the RS-bus
 //******************************************************************************************************
-void rs_interrupt(void) {
-  if (rsISR.data4IsrFlag) {
-    if (rsISR.address2use == rsISR.addressPolled) {
-      // We have data to send, it is our turn and the RSbus signal is valid
-      // Note: general USART code often includes some kind of flow control, but that is not needed here
-      *rsUSART.dataRegister = rsISR.data2send;
-      rsISR.data2sendFlag = false;         // RSbusConnection::sendNibble may now prepare new data
-      rsISR.data4IsrFlag = false;          // CheckPolling may reset the flag, is there is data2send
-      rsISR.dataWasSendFlag = true;        // used to trigger retransmission after arrors
+static inline void rs_pulse(void) __attribute__((always_inline));
+static inline void rs_pulse(void) {
+  RSBUS_STATS_START
+  #if defined(RSBUS_FIXED_ADDRESS)
+  // A single slot, and the address is an immediate value. addressPolled is read only once
+  uint8_t polled = rsISR.addressPolled;
+  if ((polled == RSBUS_FIXED_ADDRESS) && (rsISR.data4IsrMask)) {
+    *rsUSART.dataRegister = rsISR.slotPop(0); // Clears the slot bit if the queue is empty
+    rsISR.data4IsrMask = 0;                  // CheckPolling may set the bit again, if there is data2send
+    rsISR.dataWasSendFlag = true;            // used to trigger retransmission after arrors
+  }
+  rsISR.addressPolled = polled + 1;          // Address of slave that gets his turn next
+  #else
+  if (rsISR.addressPolled == rsISR.nextAddress) {
+    // One of our slots may send now. Since this is true for at most a few pulses per polling cycle,
+    // all other checks are performed only from here
+    if (rsISR.scheduleIndex < rsISR.scheduleSize) {
+      uint8_t slot = rsISR.schedule[rsISR.scheduleIndex];
+      uint8_t slotBit = (1 << slot);
+      if (rsISR.data4IsrMask & slotBit) {
+        // We have data to send, it is our turn and the RSbus signal is valid
+        // Note: general USART code often includes some kind of flow control, but that is not needed here
+        *rsUSART.dataRegister = rsISR.slotPop(slot); // Clears the slot bit if the queue is empty
+        rsISR.data4IsrMask &= ~slotBit;    // CheckPolling may set the bit again, if there is data2send
+        rsISR.dataWasSendFlag = true;      // used to trigger retransmission after arrors
+      }
+      rsISR.nextSlot();                    // Next slot in this cycle
     }
   }
   rsISR.addressPolled ++;                  // Address of slave that gets his turn next
+  #endif
+  RSBUS_STATS_STOP(isr)
+}
+
+
+void rs_interrupt(void) {                  // Called via attachInterrupt()
+  rs_pulse();
+}
+
+
+#if defined(RSBUS_SW_PCINT)
+// The vectors of all ports are defined, since the port of the RS-bus pin is only known at run time.
+// Only the pin of the RS-bus is enabled in the PCMSK registers.
+#if defined(PCINT0_vect)
+ISR(PCINT0_vect) {
+  if ((*rxPort & rxMask) == rxLevel) rs_pulse();
 }
+#endif
+#if defined(PCINT1_vect)
+ISR(PCINT1_vect) {
+  if ((*rxPort & rxMask) == rxLevel) rs_pulse();
+}
+#endif
+#if defined(PCINT2_vect)
+ISR(PCINT2_vect) {
+  if ((*rxPort & rxMask) == rxLevel) rs_pulse();
+}
+#endif
+#if defined(PCINT3_vect)
+ISR(PCINT3_vect) {
+  if ((*rxPort & rxMask) == rxLevel) rs_pulse();
+}
+#endif
+#endif
 
 
 //******************************************************************************************************
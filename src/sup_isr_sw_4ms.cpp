@@ -8,6 +8,9 @@
 // history:   2019-01-30 ap V0.1 Initial version
 //            2021-08-18 ap V0.2 millis() replaced by flag
 //            2022-07-27 ap V0.3 millis() replaced by micros()
+//            2026-10-14 ag V0.4 Transmit slots per RSbusConnection, armed at the start of each cycle
+//                               The ISR takes the data from the slot's queue
+//                               Specialised ISR for RSBUS_FIXED_ADDRESS
 //
 // This source file is subject of the GNU general public license 3,
 // that is available at the world-wide-web at http://www.gnu.org/licenses/gpl.txt
@@ -42,9 +45,7 @@ extern USART rsUSART;                // instantiated in "sup_usart.cpp" We only
 // RSbusIsr: constructor
 //**********************************************************************************************
 RSbusIsr::RSbusIsr(void) {       // Define the constructor
-  addressPolled = 0;             // Start with any address; the first polling cyclus will not be used
-  data2send = 0;                 // Empty our send data byte
-  data2sendFlag = false;         // No, we don't have anything to send yet
+  // Nothing variant specific: all attributes have their default value (see sup_isr.h)
 }
 
 
@@ -62,10 +63,13 @@ RSbusIsr::RSbusIsr(void) {       // Define the constructor
 // to stop the rs_interrupt service routine, for symmetry reasons we have decided for an "attach"
 // and "detach".
 
-RSbusHardware::RSbusHardware() {                     // Constructor
-  rsSignalIsOK = false;                              // No valid RS-bus signal detected yet
-  swapUsartPin = false;                              // We use the default USART TX pin
-  interruptModeRising = true;                        // Earlier hardware triggered on FALLING
+RSbusHardware::RSbusHardware(uint8_t busNumber) {    // Constructor
+  bus = busNumber;                                   // Always 0: this variant supports a single bus
+  isr = &rsISR;
+  clearTelemetry();                                  // Set all telemetry counters to 0
+  #if defined(RSBUS_STATISTICS)
+  clearStatistics();
+  #endif
 }
 
 void RSbusHardware::attach(uint8_t usartNumber, uint8_t rxPin) {
@@ -105,6 +109,7 @@ void RSbusHardware::detach(void) {
 //
 //************************************************************************************************
 void RSbusHardware::checkPolling(void) {
+  RSBUS_STATS_START
   if (rsISR.addressPolled != 0) {
     if (rsISR.timeIdle == 0) {
       // We already had a RS-Bus interrupt just before
@@ -116,16 +121,29 @@ void RSbusHardware::checkPolling(void) {
       if ((micros() - rsISR.tLastInterrupt) > 4000) {
         // A new RS-bus cycle has started. Reset addressPolled
         // If 130 addresses were polled, layer 1 works fine
+        cycleStarted(rsISR.addressPolled == 130);  // Telemetry
         if (rsISR.addressPolled == 130) rsSignalIsOK = true;
-        else {rsSignalIsOK = false;  }
+        else {
+          if (rsSignalIsOK) countError(telemetry.pulseCountErrors);
+          rsSignalIsOK = false;
+        }
         rsISR.addressPolled = 0;
+        rsISR.armSlots(rsISR.data2sendMask, 1);  // Slots with data waiting may send in this cycle
       }
     }
   }
   else
     if (rsSignalIsOK)
-      if ((micros() - rsISR.tLastInterrupt) > 10000) rsSignalIsOK = false; // more than 10ms silent
-  if (rsSignalIsOK == false) rsISR.data2sendFlag = false; // cancel possible data waiting for ISR
+      if ((micros() - rsISR.tLastInterrupt) > 10000) { // more than 10ms silent
+        rsSignalIsOK = false;
+        rsCount(telemetry.signalLosses);
+        cycleValid = false;              // The next cycle doesn't follow a valid cycle
+      }
+  if (rsSignalIsOK == false) {           // cancel possible data waiting for ISR
+    rsISR.data4IsrMask = 0;              // The connections will flush their queues themselves
+  }
+  checkEvents();                                       // Callbacks and serviceConnections
+  RSBUS_STATS_STOP(checkPolling)
 }
 
 
@@ -134,16 +152,33 @@ void RSbusHardware::checkPolling(void) {
 //
 //******************************************************************************************************
 void rs_interrupt(void) {
-  if (rsISR.data2sendFlag) {
-    if (rsISR.address2use == rsISR.addressPolled) {  
-      // We have data to send, it is our turn and the decoder is synchronised
-      // Note: general USART code often includes some kind of flow control, but that is not needed here
-      (*rsUSART.dataRegister) = rsISR.data2send;
-      rsISR.data2sendFlag = false;
-    } 
+  RSBUS_STATS_START
+  #if defined(RSBUS_FIXED_ADDRESS)
+  // A single slot, and the address is an immediate value. addressPolled is read only once
+  uint8_t polled = rsISR.addressPolled;
+  if ((polled == RSBUS_FIXED_ADDRESS) && (rsISR.data4IsrMask)) {
+    (*rsUSART.dataRegister) = rsISR.slotPop(0); // Clears the slot bit if the queue is empty
+    rsISR.data4IsrMask = 0;
+  }
+  rsISR.addressPolled = polled + 1;  // Address of slave that gets his turn next
+  #else
+  if (rsISR.addressPolled == rsISR.nextAddress) {
+    if (rsISR.scheduleIndex < rsISR.scheduleSize) {
+      uint8_t slot = rsISR.schedule[rsISR.scheduleIndex];
+      uint8_t slotBit = (1 << slot);
+      if (rsISR.data4IsrMask & slotBit) {
+        // We have data to send, it is our turn and the decoder is synchronised
+        // Note: general USART code often includes some kind of flow control, but that is not needed here
+        (*rsUSART.dataRegister) = rsISR.slotPop(slot); // Clears the slot bit if the queue is empty
+        rsISR.data4IsrMask &= ~slotBit;
+      }
+      rsISR.nextSlot();
+    }
   }
   rsISR.addressPolled ++;        // Address of slave that gets his turn next
+  #endif
   rsISR.timeIdle = 0;            // Reset the counter since the command station is not idle now
+  RSBUS_STATS_STOP(isr)
 }
 
 #endif // #if defined(RSBUS_USES_SW_4MS)
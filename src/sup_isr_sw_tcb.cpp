@@ -11,6 +11,12 @@
 //            traditional ATmega processors (such as the UNO).
 // history:   2021-12-13 ap V1.0 Initial version
 //            2022-07-27 ap V1.1 millis() replaced by micros()
+//            2026-10-14 ag V1.2 Transmit slots per RSbusConnection, a single compare per pulse
+//                               The ISR takes the data from the slot's queue
+//                               Pulses that follow too soon are ignored as noise
+//                               Up to three RS-bus interfaces, each with its own TCB, ISR and USART
+//                               Specialised ISR for RSBUS_FIXED_ADDRESS
+//                               Nibbles that would be send too late are held for the next cycle
 //
 // This source file is subject of the GNU general public license 3,
 // that is available at the world-wide-web at http://www.gnu.org/licenses/gpl.txt
@@ -33,24 +39,68 @@ defined(RSBUS_USES_SW_TCB3) || defined(RSBUS_USES_SW_TCB4)
 // The following objects are instantiated elsewhere, but are used here
 extern RSbusHardware rsbusHardware;  // instantiated in "RS-bus.cpp"
 extern volatile RSbusIsr rsISR;      // instantiated in "RS-bus.cpp"
-extern USART rsUSART;                // instantiated in "sup_usart.cpp" We only use init()
+extern USART rsUSART;                // instantiated in "sup_usart.cpp"
+#if (RSBUS_BUSES > 1)
+extern volatile RSbusIsr rsISR1;     // instantiated in "RS-bus.cpp"
+static USART rsUSART1;               // The USART of bus 1
+#endif
+#if (RSBUS_BUSES > 2)
+extern volatile RSbusIsr rsISR2;     // instantiated in "RS-bus.cpp"
+static USART rsUSART2;               // The USART of bus 2
+#endif
+
+#define TICKS_PER_US (F_CPU / 1000000) // TCB clock is CLK_PER (=F_CPU)
+
+// Each RS-bus interface uses its own TCB (see RSBUS_BUS1_TCB in RSbusVariants.h). The names of the
+// TCB, its CCMP register, its interrupt vector and its event user are made from the TCB number.
+#define RSBUS_CAT3(a, b, c)  a ## b ## c
+#define RSBUS_XCAT3(a, b, c) RSBUS_CAT3(a, b, c)     // Expands the arguments before they are joined
+#define RSBUS_TCB(n)         RSBUS_XCAT3(TCB, n, )   // TCBn
+#define RSBUS_TCB_CCMP(n)    RSBUS_XCAT3(TCB, n, _CCMP)
+#define RSBUS_TCB_CNT(n)     RSBUS_XCAT3(TCB, n, _CNT)
+#define RSBUS_TCB_INTFLAGS(n) RSBUS_XCAT3(TCB, n, _INTFLAGS)
+#define RSBUS_TCB_VECT(n)    RSBUS_XCAT3(TCB, n, _INT_vect)
+#define RSBUS_TCB_USER(n)    RSBUS_XCAT3(tcb, n, _capt)
+
 
+//******************************************************************************************************
+// The objects that belong to each bus. Only used outside the ISRs; the ISRs use these objects directly.
+static volatile TCB_t* tcbOfBus(uint8_t bus) {
+  #if (RSBUS_BUSES > 1)
+  if (bus == 1) return &RSBUS_TCB(RSBUS_BUS1_TCB);
+  #endif
+  #if (RSBUS_BUSES > 2)
+  if (bus == 2) return &RSBUS_TCB(RSBUS_BUS2_TCB);
+  #endif
+  return &RSBUS_TCB(RSBUS_BUS0_TCB);
+}
 
-static volatile TCB_t* _timer;       // In init and detach we use a pointer to the timer
-#define T180uS F_CPU / 1000000 * 180 // RS-bus pulses shorter than 180us will trigger an error
+
+static USART* usartOfBus(uint8_t bus) {
+  #if (RSBUS_BUSES > 1)
+  if (bus == 1) return &rsUSART1;
+  #endif
+  #if (RSBUS_BUSES > 2)
+  if (bus == 2) return &rsUSART2;
+  #endif
+  return &rsUSART;
+}
+
+
+static volatile RSbusIsr* isrOfBus(uint8_t bus) {
+  #if (RSBUS_BUSES > 1)
+  if (bus == 1) return &rsISR1;
+  #endif
+  #if (RSBUS_BUSES > 2)
+  if (bus == 2) return &rsISR2;
+  #endif
+  return &rsISR;
+}
 
 //******************************************************************************************************
 // RSbusIsr: constructor
 //******************************************************************************************************
 RSbusIsr::RSbusIsr(void) {       // Define the constructor
-  addressPolled = 0;             // Start with any address; the first polling cyclus will not be used
-  lastPulseCnt = 0;              // Any value
-  address2use = 0;               // Initialise address to 0
-  data2send = 0;                 // Empty our send data byte
-  data2sendFlag = false;         // No, we don't have anything to send yet
-  dataWasSendFlag = false;       // No, we didn't send anything yet
-  flagParity = false;            // No, we don't need to retranmit after a parity error
-  flagPulseCount = false;        // No, we don't need to retranmit after a pulse count error
   tLastCheck = micros();         // Current time
 }
 
@@ -70,29 +120,8 @@ RSbusIsr::RSbusIsr(void) {       // Define the constructor
 
 void RSbusHardware::initTcb(void) {
   // Step 1: Instead of calling a specific timer directly, in init and detach we use a pointer to the
-  // selected timer. However, since pointers add a level of indirection, the registers that we use
-  // (EVCTRL and CCMP) will be directly accessed via #defines
-#if defined(RSBUS_USES_SW_TCB0)
-  _timer = &TCB0;
-  #define timer_EVCTRL TCB0_EVCTRL
-  #define timer_CCMP   TCB0_CCMP
-#elif defined(RSBUS_USES_SW_TCB1)
-  _timer = &TCB1;
-  #define timer_EVCTRL TCB1_EVCTRL
-  #define timer_CCMP   TCB1_CCMP
-#elif defined(RSBUS_USES_SW_TCB2)
-  _timer = &TCB2;
-  #define timer_EVCTRL TCB2_EVCTRL
-  #define timer_CCMP   TCB2_CCMP
-#elif defined(RSBUS_USES_SW_TCB3)
-  _timer = &TCB3;
-  #define timer_EVCTRL TCB3_EVCTRL
-  #define timer_CCMP   TCB3_CCMP
-#elif defined(RSBUS_USES_SW_TCB4)
-  _timer = &TCB4;
-  #define timer_EVCTRL TCB4_EVCTRL
-  #define timer_CCMP   TCB4_CCMP
-#endif
+  // timer of this bus. The ISR accesses its CCMP register directly
+  volatile TCB_t* _timer = tcbOfBus(bus);
   // Step 2: fill the registers. See the data sheets for details
   noInterrupts();
   // Clear the main timer control registers. Needed since the Arduino core creates some presets
@@ -116,32 +145,27 @@ void RSbusHardware::initEventSystem(uint8_t rxPin) {
   noInterrupts();
   // Assign Event generator: a positive edge on the RS-bus input pin starts the timer
   Event& myEvent = Event::assign_generator_pin(rxPin);
-  // Set Event Users
-  #if defined(RSBUS_USES_SW_TCB0)
-    myEvent.set_user(user::tcb0_capt);
-  #elif defined(RSBUS_USES_SW_TCB1)
-    myEvent.set_user(user::tcb1_capt);
-  #elif defined(RSBUS_USES_SW_TCB2)
-    myEvent.set_user(user::tcb2_capt);
-  #elif defined(RSBUS_USES_SW_TCB3)
-    myEvent.set_user(user::tcb3_capt);
-  #elif defined(RSBUS_USES_SW_TCB4)
-    myEvent.set_user(user::tcb4_capt);
+  // Set Event Users: the TCB of this bus
+  #if (RSBUS_BUSES > 1)
+  if (bus == 1) myEvent.set_user(user::RSBUS_TCB_USER(RSBUS_BUS1_TCB));
+  #endif
+  #if (RSBUS_BUSES > 2)
+  if (bus == 2) myEvent.set_user(user::RSBUS_TCB_USER(RSBUS_BUS2_TCB));
   #endif
+  if (bus == 0) myEvent.set_user(user::RSBUS_TCB_USER(RSBUS_BUS0_TCB));
   // Start the event channel
   myEvent.start();
   interrupts();
 }
 
 
-RSbusHardware::RSbusHardware() {                     // Constructor
-  rsSignalIsOK = false;                              // No valid RS-bus signal detected yet
-  swapUsartPin = false;                              // We use the default USART TX pin
-  interruptModeRising = true;                        // Earlier hardware triggered on FALLING
-  parityErrors = 0;                                  // Counter for the number of 10,7ms gaps
-  pulseCountErrors = 0;                              // Number of times a cycli did not have 130 pulses
-  parityErrorHandling = 1;                           // Default: if we have just send data, retransmit!
-  pulseCountErrorHandling = 2;                       // Default: always retransmit all feedback data
+RSbusHardware::RSbusHardware(uint8_t busNumber) {    // Constructor
+  bus = (busNumber < RSBUS_BUSES) ? busNumber : 0;
+  isr = isrOfBus(bus);                               // Only the address; rsISRx may not be constructed yet
+  clearTelemetry();                                  // Set all telemetry counters to 0
+  #if defined(RSBUS_STATISTICS)
+  clearStatistics();
+  #endif
 }
 
 void RSbusHardware::attach(uint8_t usartNumber, uint8_t rxPin) {
@@ -149,13 +173,20 @@ void RSbusHardware::attach(uint8_t usartNumber, uint8_t rxPin) {
   rxPinUsed = rxPin;
   // STEP 1: initialise the RS bus transmission hardware (USART)
   // Use swapUsartPin to set the defaultUsartPins parameter.
-  rsUSART.init(usartNumber, !swapUsartPin);
+  usartOfBus(bus)->init(usartNumber, !swapUsartPin);
   // Step 2: attach the interrupt to the RSBUS_RX pin.
+  isr->minPeriodTicks = TICKS_PER_US * minPulsePeriod;
+  isr->rejectedTicks = 0;
+  isr->maxDelayTicks = (maxSendDelay) ? (TICKS_PER_US * maxSendDelay) : 0xFFFF;
   initTcb();
   initEventSystem(rxPin);
+  #if defined(RSBUS_SILENCE_TIMER)
+  init_timerx();                                     // A timer calls resetAddressPolled() every 2ms
+  #endif
 }
 
 void RSbusHardware::detach(void) {
+  volatile TCB_t* _timer = tcbOfBus(bus);
   noInterrupts();
   // Clear all TCB timer settings
   // For "reboot" (jmp 0) it is crucial to set INTCTRL = 0
@@ -167,31 +198,12 @@ void RSbusHardware::detach(void) {
   _timer->CNT = 0;
   _timer->INTFLAGS = 0;
   interrupts();
+  #if defined(RSBUS_SILENCE_TIMER)
+  stop_timerx();
+  #endif
 }
 
 
-//******************************************************************************************************
-void RSbusHardware::triggerRetransmission(uint8_t strategy, bool justTransmitted) {
-  // Retransmissions can be triggered by clearing the rsSignalIsOK flag.
-  // If this flag is cleared, checkConnection() sets the status to 'notSynchronised'
-  // empties the FIFO and clears the data2SendFlag.
-  // This will trigger the main sketch to retransmit (all 8 bits of) feedback data
-  switch (strategy) {
-    case 0:                                  // Do nothing
-    break;
-    case 1:                                  // Signal an error if we just transmitted
-      if (justTransmitted) rsSignalIsOK = false;
-    break;
-    case 2:                                  // Always signal an error
-      rsSignalIsOK = false;                  // Will trigger a retransmission
-    break;
-    default:                                 // Ignore
-    break;
-  }
-  // If the application will retransmit, we can cancel data ready for transmission
-  if (rsSignalIsOK == false) rsISR.data4IsrFlag = false;
-}
-
 //******************************************************************************************************
 // checkPolling(): Called from main as frequent as possible
 //******************************************************************************************************
@@ -206,57 +218,83 @@ void RSbusHardware::triggerRetransmission(uint8_t strategy, bool justTransmitted
 // - check 6: same as check 5 
 // - check 7: 12ms of silence: seems we lost the RS-signal
 void RSbusHardware::checkPolling(void) {
+  RSBUS_STATS_START
+  #if !defined(RSBUS_SILENCE_TIMER)
+  // Skip the following code, since a timer calls resetAddressPolled() every 2ms
   unsigned long currentTime = micros();                // will not chance during sub routine
-  if ((currentTime - rsISR.tLastCheck) >= 2000) {      // Check once every 2 ms
-    rsISR.tLastCheck = currentTime;   
-    uint16_t currentCnt = rsISR.addressPolled;         // will not chance during sub routine
-    if (currentCnt == rsISR.lastPulseCnt) {            // This may be a silence period
-      rsISR.timeIdle++;                                // Counts which 2ms check we are in
-      switch (rsISR.timeIdle) {                        // See figures in documentation
-      case 1:                                          // addressPolled differs from previous count
-      case 2:                                          // May also occur if UART send byte 
-      case 4:                                          // Same as case 3, nothing new
-      case 6:                                          // Same as case 5, nothing new
-      break;
-      case 3:                                          // Third check => SILENCE!
-        // Set flags for possible retransmission
-        rsISR.flagPulseCount = rsISR.dataWasSendFlag;  // ISR may set the dataWasSendFlag
-        rsISR.flagParity     = rsISR.dataWasSendFlag;  // and flags may trigger retransmission
-        rsISR.dataWasSendFlag = false;                 // but only is previous cycle had errors
-        if (rsISR.addressPolled == 130) {
-          // Step 2A: signal is OK, so tell ISR if data is waiting to be transmitted
-          rsSignalIsOK = true;
-          if (rsISR.data2sendFlag) rsISR.data4IsrFlag = true;
-        }
-        else {                                         // pulse count problem
-          if (rsSignalIsOK) {                          // Do nothing during initialisation
-            pulseCountErrors ++;
-            triggerRetransmission(pulseCountErrorHandling, rsISR.flagPulseCount);
-          }
-        }
-        rsISR.addressPolled = 0;                       // Reset 
-        rsISR.lastPulseCnt = 0;                        // Reset
-      break;
-      case 5:                                          // 8ms of silence => Parity error
-        if (rsSignalIsOK) {                            // Only act if everything was OK before
-          parityErrors++;                              // Keep track of number of parity errors
-          triggerRetransmission(parityErrorHandling, rsISR.flagParity);
+  if ((currentTime - isr->tLastCheck) >= 2000) {      // Check once every 2 ms
+    isr->tLastCheck = currentTime;
+    resetAddressPolled();
+  }
+  #endif
+  checkEvents();                                       // Callbacks and serviceConnections
+  RSBUS_STATS_STOP(checkPolling)
+}
+
+
+void RSbusHardware::resetAddressPolled(void) {
+  RSBUS_STATS_START
+  uint16_t currentCnt = isr->addressPolled;           // will not chance during sub routine
+  if (currentCnt == isr->lastPulseCnt) {              // This may be a silence period
+    isr->timeIdle++;                                  // Counts which 2ms check we are in
+    switch (isr->timeIdle) {                          // See figures in documentation
+    case 1:                                            // addressPolled differs from previous count
+    case 2:                                            // May also occur if UART send byte 
+    case 4:                                            // Same as case 3, nothing new
+    case 6:                                            // Same as case 5, nothing new
+    break;
+    case 3:                                            // Third check => SILENCE!
+      // Set flags for possible retransmission
+      isr->flagPulseCount = isr->dataWasSendFlag;    // ISR may set the dataWasSendFlag
+      isr->flagParity     = isr->dataWasSendFlag;    // and flags may trigger retransmission
+      isr->dataWasSendFlag = false;                   // but only is previous cycle had errors
+      isr->sentLastCycle = isr->sentMask;            // The bytes that selective retransmission
+      isr->sentMask = 0;                              // may send again
+      if (isr->addressPolled == 130) {
+        // Step 2A: signal is OK, so tell ISR if data is waiting to be transmitted
+        rsSignalIsOK = true;
+        cycleStarted(true);
+        isr->armSlots(isr->data2sendMask, 1);
+      }
+      else {                                           // pulse count problem
+        cycleStarted(false);                           // Telemetry: the previous cycle was not valid
+        if (rsSignalIsOK) {                            // Do nothing during initialisation
+          pulseCountErrors ++;
+          countError(telemetry.pulseCountErrors);
+          triggerRetransmission(pulseCountErrorHandling, isr->flagPulseCount);
         }
-      break;
-      case 7:                                          // 12ms of silence: RS-bus signal loss
-        if (rsSignalIsOK) parityErrors--;              // Wasn't a parity error
-        rsSignalIsOK = false;                          // Will trigger a reconnect to the master
-        rsISR.data4IsrFlag = false;                    // Cancel possible data waiting for ISR
-      break;
-      default:                                         // Silence >= 14ms
-      break;
-      };
-    }
-    else {                                             // Not a silence period
-      rsISR.lastPulseCnt = currentCnt;                 // Store current addressPolled
-      rsISR.timeIdle = 1;                              // Reset silence (idle) period counter
+      }
+      isr->addressPolled = 0;                         // Reset 
+      isr->lastPulseCnt = 0;                          // Reset
+    break;
+    case 5:                                            // 8ms of silence => Parity error
+      if (rsSignalIsOK) {                              // Only act if everything was OK before
+        parityErrors++;                                // Keep track of number of parity errors
+        parityPending = true;                          // Telemetry: counted once the silence ends
+        triggerRetransmission(parityErrorHandling, isr->flagParity);
+      }
+    break;
+    case 7:                                            // 12ms of silence: RS-bus signal loss
+      if (parityPending) parityErrors--;               // Wasn't a parity error
+      if (rsSignalIsOK || parityPending) rsCount(telemetry.signalLosses);
+      parityPending = false;                           // Not a parity error after all
+      cycleValid = false;                              // The next cycle doesn't follow a valid cycle
+      rsSignalIsOK = false;                            // Will trigger a reconnect to the master
+      isr->data4IsrMask = 0;                          // Cancel possible data waiting for ISR
+    break;
+    default:                                           // Silence >= 14ms
+    break;
+    };
+  }
+  else {                                               // Not a silence period
+    isr->lastPulseCnt = currentCnt;                   // Store current addressPolled
+    isr->timeIdle = 1;                                // Reset silence (idle) period counter
+    if (parityPending) {                               // The silence was 8..12ms: parity error
+      parityPending = false;
+      countError(telemetry.parityErrors);
     }
   }
+  RSBUS_STATS_STOP(resetAddressPolled)
 }
 
 
@@ -264,36 +302,98 @@ void RSbusHardware::checkPolling(void) {
 //******************************************************************************************************
 // Define the TCB-based Interrupt Service routine (ISR) for the RS-bus
 //******************************************************************************************************
-// Select the corresponding ISR
-#if defined(RSBUS_USES_SW_TCB0)
-  ISR(TCB0_INT_vect) {
-#elif defined(RSBUS_USES_SW_TCB1)
-  ISR(TCB1_INT_vect) {
-#elif defined(RSBUS_USES_SW_TCB2)
-  ISR(TCB2_INT_vect) {
-#elif defined(RSBUS_USES_SW_TCB3)
-  ISR(TCB3_INT_vect) {
-#elif defined(RSBUS_USES_SW_TCB4)
-  ISR(TCB4_INT_vect) {
-#endif
-  uint16_t delta = timer_CCMP;             // Delta holds the time since the previous interrupt
-  if (delta <= T180uS)
-    // Pulse count error. We lost track of where we are within the current pulse train.
-    // Therefore don't transmit during this pulse train, and let checkPolling() decide what to do
-    rsISR.data4IsrFlag = false;
-  else {
-    if (rsISR.data4IsrFlag) {
-      if (rsISR.address2use == rsISR.addressPolled) {
+// The ISR of each bus calls tcbInterrupt() with its own objects. Since tcbInterrupt() is inlined with
+// these (global) objects as parameters, the code is as fast as if the objects were used directly.
+// In Frequency Measurement mode the TCB restarts counting at every (accepted) edge, thus "elapsed"
+// (the TCB's CNT register) tells how long ago the pulse started. If the USART write would start later
+// than maxDelayTicks after the edge, the byte would (partly) fall in the slot of the next slave and be
+// corrupted. In that case the nibble stays in its queue, and is send in the next polling cycle.
+// The TCB also restarts at edges that are rejected as noise. The time must be measured from the accepted
+// edge, thus "elapsed" is only valid if no other edge was captured since. If a (noise) edge followed,
+// the time since the accepted edge is unknown here, and the write is considered late.
+static inline bool writeOnTime(volatile RSbusIsr &isr, volatile uint16_t &elapsed,
+  volatile uint8_t &intflags) __attribute__((always_inline));
+
+static inline bool writeOnTime(volatile RSbusIsr &isr, volatile uint16_t &elapsed,
+  volatile uint8_t &intflags) {
+  if (elapsed > isr.maxDelayTicks) return false;
+  return !(intflags & TCB_CAPT_bm);        // Read after CNT: no edge captured while CNT was read
+}
+
+static inline void tcbInterrupt(volatile RSbusIsr &isr, USART &usart, uint16_t period,
+  volatile uint16_t &elapsed, volatile uint8_t &intflags) __attribute__((always_inline));
+
+static inline void tcbInterrupt(volatile RSbusIsr &isr, USART &usart, uint16_t period,
+  volatile uint16_t &elapsed, volatile uint8_t &intflags) {
+  RSBUS_STATS_START
+  // CCMP holds the time since the previous interrupt. If the previous interrupt was rejected as noise,
+  // its time is added, so delta is the time since the previous valid pulse. After the period of silence
+  // CCMP may have wrapped around, so the first pulse of a pulse train is always accepted.
+  uint16_t delta = period + isr.rejectedTicks;
+  if ((delta < isr.minPeriodTicks) && (isr.addressPolled != 0)) {
+    // Noise: a spike on the RS-bus input. Ignore it, so the pulse count remains correct
+    isr.rejectedTicks = delta;
+    if (isr.pulsesRejected != 0xFFFFFFFF) isr.pulsesRejected++;
+    RSBUS_STATS_STOP(isr)
+    return;
+  }
+  isr.rejectedTicks = 0;
+  #if defined(RSBUS_FIXED_ADDRESS)
+  // A single slot, and the address is an immediate value. addressPolled is read only once
+  uint8_t polled = isr.addressPolled;
+  if ((polled == RSBUS_FIXED_ADDRESS) && (isr.data4IsrMask)) {
+    if (writeOnTime(isr, elapsed, intflags)) {
+      *usart.dataRegister = isr.slotPop(0);  // Clears the slot bit if the queue is empty
+      isr.dataWasSendFlag = true;            // used to trigger retransmission after arrors
+    }
+    else if (isr.lateSkips != 0xFFFFFFFF) isr.lateSkips++; // Too late: keep the nibble for the next cycle
+    isr.data4IsrMask = 0;                  // CheckPolling may set the bit again, if there is data2send
+  }
+  isr.addressPolled = polled + 1;          // Address of slave that gets his turn next
+  #else
+  if (isr.addressPolled == isr.nextAddress) {
+    // One of our slots may send now. Since this is true for at most a few pulses per polling cycle,
+    // all other checks are performed only from here
+    if (isr.scheduleIndex < isr.scheduleSize) {
+      uint8_t slot = isr.schedule[isr.scheduleIndex];
+      uint8_t slotBit = (1 << slot);
+      if (isr.data4IsrMask & slotBit) {
         // We have data to send, it is our turn and the RSbus signal is valid
         // Note: general USART code often includes some kind of flow control, but that is not needed here
-        *rsUSART.dataRegister = rsISR.data2send;
-        rsISR.data2sendFlag = false;         // RSbusConnection::sendNibble may now prepare new data
-        rsISR.data4IsrFlag = false;          // CheckPolling may reset the flag, is there is data2send
-        rsISR.dataWasSendFlag = true;        // used to trigger retransmission after arrors
+        if (writeOnTime(isr, elapsed, intflags)) {
+          *usart.dataRegister = isr.slotPop(slot); // Clears the slot bit if the queue is empty
+          isr.dataWasSendFlag = true;    // used to trigger retransmission after arrors
+        }
+        else if (isr.lateSkips != 0xFFFFFFFF) isr.lateSkips++; // Too late: keep the nibble for the next cycle
+        isr.data4IsrMask &= ~slotBit;    // CheckPolling may set the bit again, if there is data2send
       }
+      isr.nextSlot();                    // Next slot in this cycle
     }
   }
-  rsISR.addressPolled ++;                  // Address of slave that gets his turn next
+  isr.addressPolled ++;                  // Address of slave that gets his turn next
+  #endif
+  RSBUS_STATS_STOP(isr)
+}
+
+
+// Reading CCMP also clears the interrupt flag
+ISR(RSBUS_TCB_VECT(RSBUS_BUS0_TCB)) {
+  tcbInterrupt(rsISR, rsUSART, RSBUS_TCB_CCMP(RSBUS_BUS0_TCB),
+    RSBUS_TCB_CNT(RSBUS_BUS0_TCB), RSBUS_TCB_INTFLAGS(RSBUS_BUS0_TCB));
+}
+
+#if (RSBUS_BUSES > 1)
+ISR(RSBUS_TCB_VECT(RSBUS_BUS1_TCB)) {
+  tcbInterrupt(rsISR1, rsUSART1, RSBUS_TCB_CCMP(RSBUS_BUS1_TCB),
+    RSBUS_TCB_CNT(RSBUS_BUS1_TCB), RSBUS_TCB_INTFLAGS(RSBUS_BUS1_TCB));
 }
+#endif
+
+#if (RSBUS_BUSES > 2)
+ISR(RSBUS_TCB_VECT(RSBUS_BUS2_TCB)) {
+  tcbInterrupt(rsISR2, rsUSART2, RSBUS_TCB_CCMP(RSBUS_BUS2_TCB),
+    RSBUS_TCB_CNT(RSBUS_BUS2_TCB), RSBUS_TCB_INTFLAGS(RSBUS_BUS2_TCB));
+}
+#endif
 
 #endif // #if defined(RSBUS_USES_SW_TCB....)
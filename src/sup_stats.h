@@ -0,0 +1,85 @@
+//************************************************************************************************
+//
+// file:      sup_stats.h
+// purpose:   Support file for the RS-bus library.
+//            Bus telemetry, and optional measurement of the execution time of the ISR and the main
+//            loop functions.
+// history:   2026-10-14 ag V1.0 Initial version: execution times and telemetry
+//
+// This source file is subject of the GNU general public license 3,
+// that is available at the world-wide-web at http://www.gnu.org/licenses/gpl.txt
+//
+// rsbusHardware.telemetry is always maintained. All counters are 32 bits wide and stop at their
+// maximum value (saturate), so they can be trusted on layouts that run for days. A consistent copy
+// can be obtained with rsbusHardware.getTelemetry(). The cycle period is the time between the
+// starts of two consecutive error-free polling cycles; since the start of a cycle is detected by
+// the 2ms silence check, its resolution is 2ms.
+//
+// If RSBUS_STATISTICS is defined (see RSbusVariants.h), rsbusHardware.statistics keeps for the
+// RS-bus ISR, resetAddressPolled(), checkPolling() and checkConnection() the minimum, maximum and
+// average execution time, in microseconds. The times are measured using micros(), thus the timer
+// that is used by the Arduino core anyhow. Its resolution depends on the core: 4us on traditional
+// ATMega processors at 16MHz, 1us or better on MegaCoreX and DxCore processors.
+// Note that the measurements themselves also take time; the ISR for example becomes slower, since
+// it has to call micros() twice. Therefore only define RSBUS_STATISTICS during development.
+//
+//************************************************************************************************
+#pragma once
+#include <Arduino.h>
+
+
+struct RSbusTelemetry {
+  uint32_t cycles;                          // Polling cycles with 130 pulses
+  uint32_t periodMin;                       // Shortest cycle period (us). 0xFFFFFFFF if not measured yet
+  uint32_t periodMax;                       // Longest cycle period (us)
+  uint32_t periodAverage;                   // Moving average of the cycle period (us). 0 if not measured yet
+  uint32_t nibblesSent;                     // Nibbles written to the USART by the ISR
+  uint32_t fecCopies;                       // Extra nibbles handed over for forward error correction
+  uint32_t retransmissions;                 // RS-bus errors that triggered a retransmission of all feedback
+  uint32_t resyncs;                         // Connections that had to synchronise again with the master
+  uint32_t fifoOverflows;                   // Nibbles dropped, since the FIFO pool was full
+  uint32_t parityErrors;                    // Periods of silence of 8..12ms
+  uint32_t pulseCountErrors;                // Polling cycles that didn't have 130 pulses
+  uint32_t signalLosses;                    // Periods of silence of 12ms or more
+  uint32_t rejectedPulses;                  // SW_TCBx: pulses ignored by the noise rejection
+  uint32_t lateSkips;                       // TCB/RTC: nibbles held for the next cycle, since the write was late
+};
+
+
+inline void rsCount(uint32_t &counter) {   // Saturating increment of a telemetry counter
+  if (counter != 0xFFFFFFFF) counter++;
+}
+
+
+struct RSbusTiming {
+  uint16_t min;                             // Shortest execution time (us). 65535 if never executed
+  uint16_t max;                             // Longest execution time (us)
+  uint32_t total;                           // Sum of all execution times (us)
+  uint32_t count;                           // Number of executions
+  uint16_t average(void) const {return (count) ? (total / count) : 0;}
+};
+
+
+struct RSbusStatistics {
+  RSbusTiming isr;                          // The ISR that counts the RS-bus pulses
+  RSbusTiming resetAddressPolled;           // The 2ms silence check
+  RSbusTiming checkPolling;                 // checkPolling(), including resetAddressPolled()
+  RSbusTiming checkConnection;              // checkConnection(), of all connections together
+};
+
+
+#if defined(RSBUS_STATISTICS)
+inline void rsStatsAdd(RSbusTiming &timing, unsigned long duration) {
+  uint16_t time = (duration > 0xFFFF) ? 0xFFFF : duration;
+  if (time < timing.min) timing.min = time;
+  if (time > timing.max) timing.max = time;
+  timing.total += time;
+  timing.count++;
+}
+  // START should be the first statement of the function, STOP the last
+  #define RSBUS_STATS_START unsigned long rsStatsStart = micros();
+  #define RSBUS_STATS_STOP(timing) rsStatsAdd(rsbusHardware.statistics.timing, micros() - rsStatsStart);
+#else
+  #define RSBUS_STATS_START
+  #define RSBUS_STATS_STOP(timing)
+#endif
@@ -0,0 +1,123 @@
+//******************************************************************************************************
+//
+// file:      sup_timer.cpp
+// purpose:   Support file for the RS-bus library.
+//            Optional timer that calls resetAddressPolled() every 2ms, for the RTC, SW_TCBx, HW_TCBx
+//            and HW_TCA0 variants. Without such timer, checkPolling() should be called by the main loop
+//            at least every 2ms. See also RSbusVariants.h
+// history:   2026-10-14 ag V1.0 Initial version
+//
+// This source file is subject of the GNU general public license 3,
+// that is available at the world-wide-web at http://www.gnu.org/licenses/gpl.txt
+//
+// Two kinds of timers can be selected:
+// - a TCB in Periodic Interrupt mode, clocked by CLK_PER (=F_CPU). The TCB should not be used by
+//   the RS-bus code itself, nor by other libraries or millis() / micros().
+// - the Periodic Interrupt Timer (PIT) of the RTC, clocked by the internal 32.768kHz oscillator.
+//   After 64 RTC clock cycles an interrupt is raised, thus every 1,95ms. The PIT can not be used
+//   in combination with RSBUS_USES_RTC, since that variant clocks the RTC from the RS-bus signal.
+//
+// resetAddressPolled() will be called from within the timer ISR, and may therefore be delayed
+// by other ISRs. Since all checks are relative to the previous check, such delays are harmless.
+//
+//******************************************************************************************************
+#include <Arduino.h>
+#include "RSbus.h"
+
+// This code will only be used if we define in RSbusVariants.h one of the "RSBUS_SILENCE_*" directives
+#if defined(RSBUS_SILENCE_TIMER)
+
+
+//******************************************************************************************************
+// The following objects are instantiated elsewhere, but are used here
+extern RSbusHardware rsbusHardware;  // instantiated in "RS-bus.cpp"
+
+
+#if !defined(RSBUS_SILENCE_PIT)
+  // TCB Periodic Interrupt mode: the interrupt fires once CNT reaches CCMP
+  #define TICKS_2MS  (F_CPU / 500)  // Number of CLK_PER cycles in 2ms
+  #if (TICKS_2MS > 65536)
+  #error "F_CPU is too high for a 2ms TCB period"
+  #endif
+  #if defined(RSBUS_SILENCE_TCB0)
+    #define silenceTimer TCB0
+  #elif defined(RSBUS_SILENCE_TCB1)
+    #define silenceTimer TCB1
+  #elif defined(RSBUS_SILENCE_TCB2)
+    #define silenceTimer TCB2
+  #elif defined(RSBUS_SILENCE_TCB3)
+    #define silenceTimer TCB3
+  #elif defined(RSBUS_SILENCE_TCB4)
+    #define silenceTimer TCB4
+  #endif
+#endif
+
+
+void RSbusHardware::init_timerx() {
+  noInterrupts();               // disable all interrupts
+  #if defined(RSBUS_SILENCE_PIT)
+    while (RTC.PITSTATUS > 0) { ;}                   // Wait for all register to be synchronized
+    RTC.CLKSEL = RTC_CLKSEL_INT32K_gc;               // Internal 32.768kHz oscillator
+    RTC.PITINTCTRL = RTC_PI_bm;                      // Enable the Periodic Interrupt
+    RTC.PITCTRLA = RTC_PERIOD_CYC64_gc | RTC_PITEN_bm; // Interrupt every 64 cycles: 1,95ms
+  #else
+    silenceTimer.CTRLA = 0;                          // Stop the TCB (needed to setup)
+    silenceTimer.CTRLB = TCB_CNTMODE_INT_gc;         // Periodic Interrupt mode
+    silenceTimer.CCMP = TICKS_2MS - 1;               // Top value
+    silenceTimer.CNT = 0;
+    silenceTimer.INTFLAGS = TCB_CAPT_bm;             // Clear a possible old interrupt
+    silenceTimer.INTCTRL = TCB_CAPT_bm;              // Enable CAPT interrupts
+    silenceTimer.CTRLA = TCB_ENABLE_bm;              // Start the TCB, clock is CLK_PER (=F_CPU)
+  #endif
+  interrupts();                 // enable all interrupts
+}
+
+
+void RSbusHardware::stop_timerx() {
+  noInterrupts();               // disable all interrupts
+  #if defined(RSBUS_SILENCE_PIT)
+    RTC.PITCTRLA = 0;                                // Stop the PIT
+    RTC.PITINTCTRL = 0;
+  #else
+    silenceTimer.CTRLA = 0;                          // Stop the TCB
+    silenceTimer.INTCTRL = 0;
+  #endif
+  interrupts();                 // enable all interrupts
+}
+
+
+#if defined(RSBUS_SILENCE_PIT)
+ISR(RTC_PIT_vect) {
+  RTC.PITINTFLAGS = RTC_PI_bm;  // We have an interrupt, clear the flag
+  rsbusHardware.resetAddressPolled();
+}
+#elif defined(RSBUS_SILENCE_TCB0)
+ISR(TCB0_INT_vect) {
+  TCB0.INTFLAGS = TCB_CAPT_bm;  // We have an interrupt, clear the flag
+  rsbusHardware.resetAddressPolled();
+}
+#elif defined(RSBUS_SILENCE_TCB1)
+ISR(TCB1_INT_vect) {
+  TCB1.INTFLAGS = TCB_CAPT_bm;  // We have an interrupt, clear the flag
+  rsbusHardware.resetAddressPolled();
+}
+#elif defined(RSBUS_SILENCE_TCB2)
+ISR(TCB2_INT_vect) {
+  TCB2.INTFLAGS = TCB_CAPT_bm;  // We have an interrupt, clear the flag
+  rsbusHardware.resetAddressPolled();
+}
+#elif defined(RSBUS_SILENCE_TCB3)
+ISR(TCB3_INT_vect) {
+  TCB3.INTFLAGS = TCB_CAPT_bm;  // We have an interrupt, clear the flag
+  rsbusHardware.resetAddressPolled();
+}
+#elif defined(RSBUS_SILENCE_TCB4)
+ISR(TCB4_INT_vect) {
+  TCB4.INTFLAGS = TCB_CAPT_bm;  // We have an interrupt, clear the flag
+  rsbusHardware.resetAddressPolled();
+}
+#endif
+
+
+//******************************************************************************************************
+#endif // #if defined(RSBUS_SILENCE_TIMER)